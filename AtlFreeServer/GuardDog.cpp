@@ -1,5 +1,8 @@
 #include "pch.h"
 #include "Include/AtlFreeServer/GuardDog.h"
+#include <ComUtility/GuidTable.h>
+#include <ComUtility/ObjectPool.h>
+#include <ComUtility/ShardedCounter.h>
 #include <ComUtility/Utility.h>
 #include <future>
 #include <Interfaces/IDog.h>
@@ -8,20 +11,21 @@
 
 using namespace Microsoft::WRL;
 
-static long s_serverLock;
+// Updated by every dog and every LockServer call, and only read by DllCanUnloadNow
+static ShardedCounter s_serverLock;
 
-struct GuardDog : IDog
+struct GuardDog : IDog2
 {
     long m_count;
 
     GuardDog() : m_count(0)
     {
-        _InterlockedIncrement(&s_serverLock);
+        s_serverLock.Increment();
     }
 
     ~GuardDog()
     {
-        _InterlockedDecrement(&s_serverLock);
+        s_serverLock.Decrement();
     }
 
     ULONG __stdcall AddRef() override
@@ -35,7 +39,7 @@ struct GuardDog : IDog
 
         if (0 == result)
         {
-            delete this;
+            ObjectPool<GuardDog>::Delete(this);
         }
 
         return result;
@@ -46,10 +50,11 @@ struct GuardDog : IDog
     {
         assert(result);
 
-        if (id == __uuidof(IDog) ||
+        if (id == __uuidof(IDog2) ||
+            id == __uuidof(IDog) ||
             id == __uuidof(IUnknown))
         {
-            *result = static_cast<IDog *>(this);
+            *result = static_cast<IDog2 *>(this);
         }
         else
         {
@@ -71,17 +76,45 @@ struct GuardDog : IDog
     {
         return postman->OnBitten();
     }
+
+    // One call from the client for all victims. Each victim is still notified through
+    // its own OnBitten call, and a failing victim does not stop the others from being bitten.
+    HRESULT BiteAll(ULONG count, IPostman** victims, HRESULT* results) override
+    {
+        if (count && (!victims || !results))
+        {
+            return E_POINTER;
+        }
+
+        auto hr = S_OK;
+
+        for (ULONG i = 0; i < count; ++i)
+        {
+            results[i] = victims[i] ? victims[i]->OnBitten() : E_POINTER;
+
+            if (FAILED(results[i]))
+            {
+                hr = S_FALSE;
+            }
+        }
+
+        return hr;
+    }
 };
 
-struct PuppyFarm : IClassFactory
+// The class objects are static, so a reference to them locks the server instead of keeping
+// them alive. This keeps the dll loaded while a client or a stub holds a class object.
+struct PuppyFarm : IClassFactory, IPuppyFarm
 {
     ULONG __stdcall AddRef() override
     {
+        s_serverLock.Increment();
         return 2;
     }
 
     ULONG __stdcall Release() override
     {
+        s_serverLock.Decrement();
         return 1;
     }
 
@@ -95,12 +128,17 @@ struct PuppyFarm : IClassFactory
         {
             *result = static_cast<IClassFactory *>(this);
         }
+        else if (id == __uuidof(IPuppyFarm))
+        {
+            *result = static_cast<IPuppyFarm *>(this);
+        }
         else
         {
             *result = 0;
             return E_NOINTERFACE;
         }
 
+        static_cast<IUnknown *>(*result)->AddRef();
         return S_OK;
     }
 
@@ -116,13 +154,15 @@ struct PuppyFarm : IClassFactory
             return CLASS_E_NOAGGREGATION;
         }
 
-        auto dog = new (std::nothrow) GuardDog;
+        // Dogs come from a pool, since clients tend to create and release many of them
+        auto memory = ObjectPool<GuardDog>::Allocate();
 
-        if (!dog)
+        if (!memory)
         {
             return E_OUTOFMEMORY;
         }
 
+        auto dog = new (memory) GuardDog;
         dog->AddRef();
         auto hr = dog->QueryInterface(iid, result);
         dog->Release();
@@ -134,17 +174,132 @@ struct PuppyFarm : IClassFactory
     {
         if (lock)
         {
-            _InterlockedIncrement(&s_serverLock);
+            s_serverLock.Increment();
+        }
+        else
+        {
+            s_serverLock.Decrement();
+        }
+
+        return S_OK;
+    }
+
+    // Out of process, all dogs are created with a single round trip
+    HRESULT __stdcall CreateDogs(ULONG count,
+                                 IDog ** dogs) override
+    {
+        if (count == 0)
+        {
+            return S_OK;
+        }
+
+        if (!dogs)
+        {
+            return E_POINTER;
+        }
+
+        for (ULONG i = 0; i < count; ++i)
+        {
+            auto hr = CreateInstance(nullptr,
+                                     __uuidof(IDog),
+                                     reinterpret_cast<void **>(&dogs[i]));
+
+            if (S_OK != hr)
+            {
+                // All or nothing, so that the caller never has to release a partial batch
+                for (ULONG created = 0; created < i; ++created)
+                {
+                    dogs[created]->Release();
+                    dogs[created] = nullptr;
+                }
+
+                return hr;
+            }
+        }
+
+        return S_OK;
+    }
+};
+
+static PuppyFarm s_farm;
+
+// Class object of the PuppyFarm class. Creating a PuppyFarm gives out the GuardDog class object,
+// which lets clients reach IPuppyFarm through a surrogate that only exposes IClassFactory.
+struct PuppyFarmFactory : IClassFactory
+{
+    ULONG __stdcall AddRef() override
+    {
+        s_serverLock.Increment();
+        return 2;
+    }
+
+    ULONG __stdcall Release() override
+    {
+        s_serverLock.Decrement();
+        return 1;
+    }
+
+    HRESULT __stdcall QueryInterface(IID const & id,
+                                     void ** result) override
+    {
+        assert(result);
+
+        if (id == __uuidof(IClassFactory) ||
+            id == __uuidof(IUnknown))
+        {
+            *result = static_cast<IClassFactory *>(this);
         }
         else
         {
-            _InterlockedDecrement(&s_serverLock);
+            *result = 0;
+            return E_NOINTERFACE;
         }
 
+        static_cast<IUnknown *>(*result)->AddRef();
         return S_OK;
     }
+
+    HRESULT __stdcall CreateInstance(IUnknown * outer,
+                                     IID const & iid,
+                                     void ** result) override
+    {
+        assert(result);
+        *result = nullptr;
+
+        if (outer)
+        {
+            return CLASS_E_NOAGGREGATION;
+        }
+
+        return s_farm.QueryInterface(iid, result);
+    }
+
+    HRESULT __stdcall LockServer(BOOL lock) override
+    {
+        return s_farm.LockServer(lock);
+    }
 };
 
+static PuppyFarmFactory s_farmFactory;
+
+using GetClassObject = HRESULT (*)(IID const & iid, void ** result);
+
+// Class objects of this dll by CLSID. The table is sorted at compile time, and a lookup is a binary search.
+// The CLSIDs come from the uuid declarations in GuardDog.h, and must match the registration table in Registration.cpp.
+static constexpr GuidTableEntry<GetClassObject> s_classObjectEntries[] =
+{
+    {
+        ToGuidValue(__uuidof(GuardDog)),
+        [](IID const & iid, void ** result) { return s_farm.QueryInterface(iid, result); }
+    },
+    {
+        ToGuidValue(__uuidof(PuppyFarm)),
+        [](IID const & iid, void ** result) { return s_farmFactory.QueryInterface(iid, result); }
+    },
+};
+
+static constexpr auto s_classObjects = MakeGuidTable(s_classObjectEntries);
+
 // The following function is implemented in the auto-generated dlldata.c file from the Interfaces project
 extern "C"
 HRESULT __stdcall ProxyDllGetClassObject(CLSID const & clsid,
@@ -172,23 +327,15 @@ HRESULT __stdcall DllGetClassObject(CLSID const & clsid,
     assert(result);
     *result = nullptr;
 
-    auto hr = ProxyDllGetClassObject(clsid,
-                                     iid,
-                                     result);
-
-    if (CLASS_E_CLASSNOTAVAILABLE != hr)
+    // Our own classes are looked up first, so that their activation does not pay for the proxy lookup
+    if (auto const getClassObject = s_classObjects.Find(ToGuidValue(clsid)))
     {
-        return hr;
-    }
-
-    if (__uuidof(GuardDog) == clsid)
-    {
-        static PuppyFarm farm;
-
-        return farm.QueryInterface(iid, result);
+        return (*getClassObject)(iid, result);
     }
 
-    return CLASS_E_CLASSNOTAVAILABLE;
+    return ProxyDllGetClassObject(clsid,
+                                  iid,
+                                  result);
 }
 
 // The following function is implemented in the auto-generated dlldata.c file from the Interfaces project
@@ -204,5 +351,20 @@ HRESULT __stdcall DllCanUnloadNow()
         return hr;
     }
 
-    return s_serverLock ? S_FALSE : S_OK;
+    return s_serverLock.Count() ? S_FALSE : S_OK;
+}
+
+// Called by the C runtime, so the name must not be mangled
+extern "C"
+BOOL __stdcall DllMain(HINSTANCE, DWORD reason, LPVOID reserved)
+{
+    // Unloaded with FreeLibrary after DllCanUnloadNow, so no dog is alive. The pool and the
+    // caches of other threads live in this dll, so give their blocks back to the heap. At
+    // process exit, reserved is not null, and the memory goes away with the process.
+    if (reason == DLL_PROCESS_DETACH && !reserved)
+    {
+        ObjectPool<GuardDog>::ReleaseMemory();
+    }
+
+    return TRUE;
 }
@@ -3,3 +3,7 @@
 #include <unknwn.h>
 
 struct __declspec(uuid("d162d2f7-cdf4-44bc-8018-6058420bcfdc")) GuardDog;
+
+/** Class that hands out the IPuppyFarm of the GuardDog class object. Allows batch creation
+ * of GuardDogs with CLSCTX_LOCAL_SERVER, where the class object is hidden by the surrogate. */
+struct __declspec(uuid("55dd9580-fcaf-433c-a287-dd995b834065")) PuppyFarm;
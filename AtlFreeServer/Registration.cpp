@@ -1,6 +1,8 @@
 #include "pch.h"
+#include <ComUtility/RegistryBackend.h>
 #include <wrl/wrappers/corewrappers.h>
-#include <cassert>
+#include <string>
+#include <system_error>
 #include <ktmw32.h>
 #pragma comment(lib, "ktmw32.lib")
 
@@ -145,6 +147,32 @@ static Entry Table[] =
         L"Free"
     },
 
+    // Registration of the PuppyFarm COM class, which gives out the class object of GuardDog.
+    // Registered with the same AppID, so that a client can create dogs in batches in the
+    // dllhost.exe process.
+    {
+        L"Software\\Classes\\CLSID\\{55dd9580-fcaf-433c-a287-dd995b834065}",
+        EntryOption::Delete,
+        nullptr,
+        L"PuppyFarm COM class"
+    },
+    {
+        L"Software\\Classes\\CLSID\\{55dd9580-fcaf-433c-a287-dd995b834065}",
+        EntryOption::None,
+        L"AppID",
+        L"{2b083fea-3681-4c9b-9ed1-3e866124a58d}"
+    },
+    {
+        L"Software\\Classes\\CLSID\\{55dd9580-fcaf-433c-a287-dd995b834065}\\InprocServer32",
+        EntryOption::FileName
+    },
+    {
+        L"Software\\Classes\\CLSID\\{55dd9580-fcaf-433c-a287-dd995b834065}\\InprocServer32",
+        EntryOption::None,
+        L"ThreadingModel",
+        L"Free"
+    },
+
     // Register the proxy dll CLSID. I think we can choose any guid, but the common way
     // is to use the first UID found in the IDog.idl file, namely the IDog uuid.
     // Interfaces will refer to this GUID to identify the dll containing the proxy/stub implementation.
@@ -181,6 +209,34 @@ static Entry Table[] =
         L"{69fd604f-493c-4344-94b8-ea4179dd5113}" // Refer to the Proxy dll CLSID
     },
 
+    // Register the IDog2 interface
+    {
+        L"Software\\Classes\\Interface\\{59e7b6b6-ac1a-4af4-b09c-7de483c7a5ad}",
+        EntryOption::Delete,
+        nullptr,
+        L"IDog2 interface"
+    },
+    {
+        L"Software\\Classes\\Interface\\{59e7b6b6-ac1a-4af4-b09c-7de483c7a5ad}\\ProxyStubClsid32",
+        EntryOption::None,
+        nullptr,
+        L"{69fd604f-493c-4344-94b8-ea4179dd5113}" // Refer to the Proxy dll CLSID
+    },
+
+    // Register the IPuppyFarm interface, which shares the proxy dll with IDog
+    {
+        L"Software\\Classes\\Interface\\{2db739d7-6540-4412-9afa-242fa88ed480}",
+        EntryOption::Delete,
+        nullptr,
+        L"IPuppyFarm interface"
+    },
+    {
+        L"Software\\Classes\\Interface\\{2db739d7-6540-4412-9afa-242fa88ed480}\\ProxyStubClsid32",
+        EntryOption::None,
+        nullptr,
+        L"{69fd604f-493c-4344-94b8-ea4179dd5113}" // Refer to the Proxy dll CLSID
+    },
+
     // Register the IPostman interface since we will be using it via remoting
     {
         L"Software\\Classes\\Interface\\{d6ae480c-8b07-41f0-bea4-9eb3c7ed8d91}",
@@ -196,28 +252,63 @@ static Entry Table[] =
     }
 };
 
-bool Unregister(Transaction const & transaction)
+/** Writes to HKEY_LOCAL_MACHINE as part of a transaction */
+class TransactedRegistry final : public RegistryBackend
 {
-    for (auto const & entry : Table)
+public:
+    explicit TransactedRegistry(Transaction const & transaction) :
+        m_transaction(transaction)
+    {
+    }
+
+    std::error_code WriteKey(RegistryKeyWrite const & write) override
     {
-        if (EntryOption::Delete != entry.Option)
+        auto key = CreateRegistryKey(HKEY_LOCAL_MACHINE,
+                                     write.path.c_str(),
+                                     m_transaction,
+                                     KEY_WRITE);
+
+        if (!key.IsValid())
+        {
+            return LastError();
+        }
+
+        for (auto const & value : write.values)
         {
-            continue;
+            auto result = RegSetValueEx(key.Get(),
+                                        value.name.empty() ? nullptr : value.name.c_str(),
+                                        0, // reserved
+                                        REG_SZ,
+                                        reinterpret_cast<BYTE const *>(value.data.c_str()),
+                                        static_cast<DWORD>(sizeof(wchar_t) * (value.data.size() + 1)));
+
+            if (ERROR_SUCCESS != result)
+            {
+                printf("RegSetValueEx failed %d\n", result);
+                return { static_cast<int>(result), std::system_category() };
+            }
         }
 
+        return {};
+    }
+
+    std::error_code DeleteTree(std::wstring_view path) override
+    {
+        std::wstring const terminated{ path };
+
         auto key = OpenRegistryKey(HKEY_LOCAL_MACHINE,
-                                   entry.Path,
-                                   transaction,
+                                   terminated.c_str(),
+                                   m_transaction,
                                    DELETE | KEY_ENUMERATE_SUB_KEYS | KEY_QUERY_VALUE | KEY_SET_VALUE);
 
         if (!key.IsValid())
         {
             if (ERROR_FILE_NOT_FOUND == GetLastError())
             {
-                continue;
+                return {};
             }
 
-            return false;
+            return LastError();
         }
 
         auto result = RegDeleteTree(key.Get(),
@@ -225,77 +316,86 @@ bool Unregister(Transaction const & transaction)
 
         if (ERROR_SUCCESS != result)
         {
-            SetLastError(result);
-            return false;
+            return { static_cast<int>(result), std::system_category() };
         }
-    }
 
-    return true;
-}
-
-extern "C" IMAGE_DOS_HEADER __ImageBase; // Trickery to get path to current dll
+        return {};
+    }
 
-bool Register(Transaction const & transaction)
-{
-    if (!Unregister(transaction))
+private:
+    static std::error_code LastError()
     {
-        return false;
+        return { static_cast<int>(GetLastError()), std::system_category() };
     }
 
-    wchar_t filename[MAX_PATH];
-
-    auto const length = GetModuleFileName(reinterpret_cast<HMODULE>(&__ImageBase), //s_serverModule,
-                                          filename,
-                                          _countof(filename));
+    Transaction const & m_transaction;
+};
 
-    if (0 == length || _countof(filename) == length)
-    {
-        return false;
-    }
+/** Collects the Table into one write per key, so that each key is opened once */
+RegistryBatch CreateBatch(wchar_t const * filename)
+{
+    RegistryBatch batch;
 
     for (auto const & entry : Table)
     {
-        auto key = CreateRegistryKey(HKEY_LOCAL_MACHINE,
-                                     entry.Path,
-                                     transaction,
-                                     KEY_WRITE);
-
-        if (!key.IsValid())
+        if (EntryOption::Delete == entry.Option)
         {
-            return false;
+            batch.DeleteTree(entry.Path);
         }
 
-        if (EntryOption::FileName != entry.Option && !entry.Value)
+        if (EntryOption::FileName == entry.Option)
         {
-            continue;
+            batch.SetValue(entry.Path, L"", filename);
         }
-
-        auto value = entry.Value;
-
-        if (!value)
+        else if (entry.Value)
         {
-            assert(EntryOption::FileName == entry.Option);
-            value = filename;
+            batch.SetValue(entry.Path, entry.Name ? entry.Name : L"", entry.Value);
         }
-
-        auto result = RegSetValueEx(key.Get(),
-                                    entry.Name,
-                                    0, // reserved
-                                    REG_SZ,
-                                    reinterpret_cast<BYTE const *>(value),
-                                    static_cast<DWORD>(sizeof(wchar_t) * (wcslen(value) + 1)));
-
-        if (ERROR_SUCCESS != result)
+        else
         {
-            printf("RegSetValueEx failed %d\n", result);
-            SetLastError(result);
-            return false;
+            batch.CreateKey(entry.Path);
         }
     }
 
+    return batch;
+}
+
+bool Succeeded(std::error_code const & error)
+{
+    if (error)
+    {
+        SetLastError(static_cast<DWORD>(error.value()));
+        return false;
+    }
+
     return true;
 }
 
+bool Unregister(RegistryBackend & backend)
+{
+    return Succeeded(CreateBatch(L"").Delete(backend));
+}
+
+extern "C" IMAGE_DOS_HEADER __ImageBase; // Trickery to get path to current dll
+
+bool Register(RegistryBackend & backend)
+{
+    wchar_t filename[MAX_PATH];
+
+    auto const length = GetModuleFileName(reinterpret_cast<HMODULE>(&__ImageBase), //s_serverModule,
+                                          filename,
+                                          _countof(filename));
+
+    if (0 == length || _countof(filename) == length)
+    {
+        return false;
+    }
+
+    auto const batch = CreateBatch(filename);
+
+    return Succeeded(batch.Delete(backend)) && Succeeded(batch.Write(backend));
+}
+
 HRESULT __stdcall DllRegisterServer()
 {
     auto transaction = CreateTransaction();
@@ -305,7 +405,9 @@ HRESULT __stdcall DllRegisterServer()
         return HRESULT_FROM_WIN32(GetLastError());
     }
 
-    if (!Register(transaction))
+    TransactedRegistry registry{ transaction };
+
+    if (!Register(registry))
     {
         return HRESULT_FROM_WIN32(GetLastError());
     }
@@ -327,7 +429,9 @@ HRESULT __stdcall DllUnregisterServer()
         return HRESULT_FROM_WIN32(GetLastError());
     }
 
-    if (!Unregister(transaction))
+    TransactedRegistry registry{ transaction };
+
+    if (!Unregister(registry))
     {
         return HRESULT_FROM_WIN32(GetLastError());
     }
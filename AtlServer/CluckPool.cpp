@@ -0,0 +1,55 @@
+#include "pch.h"
+#include "CluckPool.h"
+#include <algorithm>
+#include <new>
+#include <thread>
+
+HRESULT CluckPool::Instance(CluckPool** pool) noexcept
+{
+    try
+    {
+        static const auto instance = new CluckPool;
+        *pool = instance;
+        return S_OK;
+    }
+    catch (const ComException& e)
+    {
+        return e.result; // The workers failed to join the multithreaded apartment
+    }
+    catch (const std::bad_alloc&)
+    {
+        return E_OUTOFMEMORY;
+    }
+    catch (...)
+    {
+        return E_FAIL; // The workers could not be started
+    }
+}
+
+CluckPool::CluckPool()
+    : m_workers{std::clamp<size_t>(std::thread::hardware_concurrency(), 2, 8)}
+{
+    HMODULE module = nullptr;
+    GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_PIN,
+                       reinterpret_cast<LPCWSTR>(&CluckPool::Instance),
+                       &module);
+}
+
+HRESULT CluckPool::SubmitCluck(IAsyncCluckObserver* observer) noexcept
+{
+    if (!observer)
+        return E_POINTER;
+
+    CComPtr<IAgileReference> agile;
+    const auto result = RoGetAgileReference(AGILEREFERENCE_DEFAULT, __uuidof(IAsyncCluckObserver), observer, &agile);
+    if (result != S_OK)
+        return result;
+
+    return Submit([agile = std::move(agile)] {
+        CComPtr<IAsyncCluckObserver> observer;
+        const auto result = agile->Resolve(__uuidof(IAsyncCluckObserver), reinterpret_cast<void**>(&observer));
+        if (result != S_OK)
+            return result;
+        return observer->OnCluck();
+    });
+}
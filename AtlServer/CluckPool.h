@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <Interfaces/IHen.h>
+#include <ComUtility/Utility.h>
+#include <ComUtility/MtaThreadPool.h>
+
+/** Workers in the multithreaded apartment that call the observers of all hens in the process.
+ * The workers join the apartment once, and the number of workers bounds the number of
+ * callbacks in progress.
+ *
+ * The pool lives until the process exits. It can not be destroyed when the dll is
+ * unloaded, since joining threads under the loader lock deadlocks, so the dll is pinned
+ * in memory instead once the pool exists. */
+class CluckPool final
+{
+public:
+    /** Callbacks that may wait for a worker before Submit refuses new ones */
+    static constexpr size_t MaxPending = 16384;
+
+    /** Get the pool, and start the workers on first use */
+    static HRESULT Instance(CluckPool** pool) noexcept;
+
+    /** Call the observer on a worker. The observer may belong to the apartment of the caller,
+     * so the worker gets an agile reference to it. */
+    HRESULT SubmitCluck(IAsyncCluckObserver* observer) noexcept;
+
+    /** Run a callback that returns an HRESULT on a worker. Returns
+     * HRESULT_FROM_WIN32(ERROR_NOT_ENOUGH_QUOTA) when too many callbacks are pending.
+     * Failures of the callback are written to the debugger output. */
+    template <typename Callback>
+    HRESULT Submit(Callback callback) noexcept
+    {
+        if (m_pending.fetch_add(1, std::memory_order_relaxed) >= MaxPending)
+        {
+            m_pending.fetch_sub(1, std::memory_order_relaxed);
+            return HRESULT_FROM_WIN32(ERROR_NOT_ENOUGH_QUOTA);
+        }
+
+        try
+        {
+            m_workers.Post([this, callback = std::move(callback)]() mutable noexcept {
+                // Give the slot back also when the callback throws
+                const PendingSlot slot{m_pending};
+                HRESULT result = S_OK;
+                try
+                {
+                    result = callback();
+                }
+                catch (const ComException& e)
+                {
+                    result = e.result;
+                }
+                catch (const std::bad_alloc&)
+                {
+                    result = E_OUTOFMEMORY;
+                }
+                catch (...)
+                {
+                    result = E_FAIL;
+                }
+
+                // Failed callbacks can not be returned to the caller, which has moved on
+                if (FAILED(result))
+                    WriteToDebugger(L"CluckPool: Callback", result);
+            });
+            return S_OK;
+        }
+        catch (const std::bad_alloc&)
+        {
+            m_pending.fetch_sub(1, std::memory_order_relaxed);
+            return E_OUTOFMEMORY;
+        }
+    }
+
+private:
+    /** Gives a pending slot back when it goes out of scope */
+    class PendingSlot final
+    {
+    public:
+        explicit PendingSlot(std::atomic<size_t>& pending) noexcept : m_pending(pending) {}
+
+        ~PendingSlot()
+        {
+            m_pending.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        PendingSlot(const PendingSlot&) = delete;
+        PendingSlot& operator=(const PendingSlot&) = delete;
+
+    private:
+        std::atomic<size_t>& m_pending;
+    };
+
+    CluckPool();
+
+    MtaThreadPool m_workers;
+    std::atomic<size_t> m_pending = 0;
+};
@@ -1,9 +1,7 @@
 #include "pch.h"
 #include "FreeThreadedHen.h"
+#include "CluckPool.h"
 #include <cassert>
-#include <future>
-#include <ComUtility/Utility.h>
-#include <winrt/base.h>
 
 HRESULT FreeThreadedHen::FinalConstruct()
 {
@@ -18,13 +16,10 @@ HRESULT FreeThreadedHen::Cluck()
 
 HRESULT FreeThreadedHen::CluckAsync(IAsyncCluckObserver* cluckObserver)
 {
-    winrt::com_ptr<IAsyncCluckObserver> observer;
-    observer.copy_from(cluckObserver);
+    CluckPool* pool = nullptr;
+    const auto result = CluckPool::Instance(&pool);
+    if (result != S_OK)
+        return result;
 
-    auto result = std::async(std::launch::async, [observer] {
-        ComRuntime comRuntime{ Apartment::MultiThreaded };
-        return observer->OnCluck();
-    });
-
-    return result.get();
+    return pool->SubmitCluck(cluckObserver);
 }
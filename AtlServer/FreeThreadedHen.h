@@ -25,6 +25,11 @@ public:
     HRESULT FinalConstruct();
 
     HRESULT Cluck() override;
+
+    /** Returns as soon as the callback is queued. The observer is called on a pool of
+     * workers in the multithreaded apartment that is shared by all hens in the process.
+     * Returns HRESULT_FROM_WIN32(ERROR_NOT_ENOUGH_QUOTA) when too many callbacks are
+     * pending. Failed callbacks are written to the debugger output. */
     HRESULT CluckAsync(IAsyncCluckObserver* cluckObserver) override;
 
 private:
@@ -0,0 +1,157 @@
+#include "pch.h"
+#include "SubscriptionHen.h"
+#include <algorithm>
+#include <new>
+#include <olectl.h>
+#include "CluckPool.h"
+
+HRESULT SubscriptionHen::FinalConstruct()
+{
+    return CoCreateFreeThreadedMarshaler(GetControllingUnknown(), &m_marshaler);
+}
+
+HRESULT SubscriptionHen::Cluck()
+{
+    CluckPool* pool = nullptr;
+    auto result = CluckPool::Instance(&pool);
+    if (result != S_OK)
+        return result;
+
+    // A batch that can not be queued does not stop the following batches, so one full
+    // queue skips as few subscribers as possible
+    HRESULT first = S_OK;
+    const auto subscribers = std::atomic_load(&m_subscribers);
+    for (size_t group = 0; group < subscribers->size(); ++group)
+    {
+        const auto count = (*subscribers)[group].subscribers.size();
+        for (size_t begin = 0; begin < count; begin += ObserversPerBatch)
+        {
+            const auto end = std::min(begin + ObserversPerBatch, count);
+
+            // The batch keeps the snapshot alive, so later writers can not release its observers
+            result = pool->Submit([subscribers, group, begin, end] {
+                return NotifyBatch((*subscribers)[group], begin, end);
+            });
+            if (result != S_OK && first == S_OK)
+                first = result;
+        }
+    }
+
+    return first;
+}
+
+HRESULT SubscriptionHen::CluckAsync(IAsyncCluckObserver* cluckObserver)
+{
+    CluckPool* pool = nullptr;
+    const auto result = CluckPool::Instance(&pool);
+    if (result != S_OK)
+        return result;
+
+    return pool->SubmitCluck(cluckObserver);
+}
+
+HRESULT SubscriptionHen::Subscribe(IAsyncCluckObserver* observer, unsigned long* cookie)
+{
+    if (!observer || !cookie)
+        return E_POINTER;
+
+    ULONG_PTR apartment = 0;
+    auto result = CoGetContextToken(&apartment);
+    if (result != S_OK)
+        return result;
+
+    CComPtr<IContextCallback> context;
+    result = CoGetObjectContext(IID_PPV_ARGS(&context));
+    if (result != S_OK)
+        return result;
+
+    CComPtr<IAgileReference> agile;
+    result = RoGetAgileReference(AGILEREFERENCE_DEFAULT, __uuidof(IAsyncCluckObserver), observer, &agile);
+    if (result != S_OK)
+        return result;
+
+    try
+    {
+        std::lock_guard guard(m_writeMutex);
+        auto subscribers = std::make_shared<Subscribers>(*std::atomic_load(&m_subscribers));
+
+        auto group = std::find_if(subscribers->begin(), subscribers->end(), [apartment](const Group& candidate) {
+            return candidate.apartment == apartment;
+        });
+        if (group == subscribers->end())
+            group = subscribers->insert(subscribers->end(), Group{apartment, context, {}});
+
+        group->subscribers.push_back({m_nextCookie, agile});
+        std::atomic_store(&m_subscribers, std::shared_ptr<const Subscribers>{std::move(subscribers)});
+
+        *cookie = m_nextCookie++;
+        return S_OK;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return E_OUTOFMEMORY;
+    }
+}
+
+HRESULT SubscriptionHen::Unsubscribe(unsigned long cookie)
+{
+    try
+    {
+        std::lock_guard guard(m_writeMutex);
+        auto subscribers = std::make_shared<Subscribers>(*std::atomic_load(&m_subscribers));
+
+        for (auto group = subscribers->begin(); group != subscribers->end(); ++group)
+        {
+            const auto subscriber = std::find_if(group->subscribers.begin(), group->subscribers.end(), [cookie](const Subscriber& candidate) {
+                return candidate.cookie == cookie;
+            });
+            if (subscriber == group->subscribers.end())
+                continue;
+
+            group->subscribers.erase(subscriber);
+            if (group->subscribers.empty())
+                subscribers->erase(group);
+
+            std::atomic_store(&m_subscribers, std::shared_ptr<const Subscribers>{std::move(subscribers)});
+            return S_OK;
+        }
+
+        return CONNECT_E_NOCONNECTION;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return E_OUTOFMEMORY;
+    }
+}
+
+HRESULT SubscriptionHen::NotifyBatch(const Group& group, size_t begin, size_t end)
+{
+    struct Batch
+    {
+        const Group& group;
+        size_t begin;
+        size_t end;
+    } batch{group, begin, end};
+
+    ComCallData data{};
+    data.pUserDefined = &batch;
+
+    // Enter the apartment once, and call all observers of the batch from within it.
+    // The first failure is returned, but does not stop the remaining observers.
+    return group.context->ContextCallback(
+        [](ComCallData* data) {
+            const auto& batch = *static_cast<Batch*>(data->pUserDefined);
+            HRESULT first = S_OK;
+            for (auto i = batch.begin; i < batch.end; ++i)
+            {
+                CComPtr<IAsyncCluckObserver> observer;
+                auto result = batch.group.subscribers[i].observer->Resolve(__uuidof(IAsyncCluckObserver), reinterpret_cast<void**>(&observer));
+                if (result == S_OK)
+                    result = observer->OnCluck();
+                if (FAILED(result) && first == S_OK)
+                    first = result;
+            }
+            return first;
+        }, &data, IID_ICallbackWithNoReentrancyToApplicationSTA, 5, nullptr);
+    // 'IID_ICallbackWithNoReentrancyToApplicationSTA, 5' means No ASTA reentrancy
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "resource.h" // main symbols
+#include <AtlServer/AtlServer.h>
+#include <ctxtcall.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace ATL;
+
+/** A hen that notifies all subscribed observers when it clucks.
+ *
+ * Observers are grouped by the apartment they were subscribed from. A cluck sends one
+ * callback per batch of observers to the shared pool of workers, and each callback enters
+ * the apartment once to call every observer in its batch. Batches run in parallel.
+ *
+ * The subscriber list is copy-on-write. A cluck notifies the list as it was when the cluck
+ * started, so subscribing and unsubscribing never wait for notifications in progress.
+ */
+class ATL_NO_VTABLE SubscriptionHen :
+    public CComObjectRootEx<CComMultiThreadModel>,
+    public CComCoClass<SubscriptionHen, &CLSID_SubscriptionHen>,
+    public ISubscribableHen
+{
+public:
+    DECLARE_REGISTRY_RESOURCEID(IDR_HEN)
+    DECLARE_PROTECT_FINAL_CONSTRUCT()
+    DECLARE_GET_CONTROLLING_UNKNOWN()
+
+    BEGIN_COM_MAP(SubscriptionHen)
+        COM_INTERFACE_ENTRY(ISubscribableHen)
+        COM_INTERFACE_ENTRY(IHen)
+        COM_INTERFACE_ENTRY_AGGREGATE(IID_IMarshal, m_marshaler)
+    END_COM_MAP()
+
+    /** Observers that are called in one apartment hop */
+    static constexpr size_t ObserversPerBatch = 64;
+
+    HRESULT FinalConstruct();
+
+    /** Returns as soon as all batches are queued. Every batch is queued even if an earlier
+     * one could not be, so a failure means that the subscribers of some batches were skipped
+     * while the others are still notified. The error of the first batch that could not be
+     * queued is returned. Failed callbacks are written to the debugger output. */
+    HRESULT Cluck() override;
+
+    /** Notifies the single observer as FreeThreadedHen does, without subscribing it */
+    HRESULT CluckAsync(IAsyncCluckObserver* cluckObserver) override;
+
+    /** The observer is called in the apartment of the caller */
+    HRESULT Subscribe(IAsyncCluckObserver* observer, unsigned long* cookie) override;
+
+    /** Returns CONNECT_E_NOCONNECTION if no observer is subscribed with the cookie */
+    HRESULT Unsubscribe(unsigned long cookie) override;
+
+private:
+    struct Subscriber
+    {
+        unsigned long cookie;
+        CComPtr<IAgileReference> observer;
+    };
+
+    /** Observers that were subscribed from the same apartment */
+    struct Group
+    {
+        ULONG_PTR apartment;
+        CComPtr<IContextCallback> context;
+        std::vector<Subscriber> subscribers;
+    };
+
+    using Subscribers = std::vector<Group>;
+
+    /** Call the observers of group in the range [begin, end) from its apartment */
+    static HRESULT NotifyBatch(const Group& group, size_t begin, size_t end);
+
+    CComPtr<IUnknown> m_marshaler;
+
+    /** Serializes writers. Readers take a snapshot with std::atomic_load */
+    std::mutex m_writeMutex;
+    std::shared_ptr<const Subscribers> m_subscribers = std::make_shared<const Subscribers>();
+    unsigned long m_nextCookie = 1;
+};
+
+OBJECT_ENTRY_AUTO(CLSID_SubscriptionHen, SubscriptionHen)
@@ -0,0 +1,197 @@
+#include <ComUtility/PriorityTaskDispatcher.h>
+#include <ComUtility/SmallFunction.h>
+#include <ComUtility/TaskFuture.h>
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+namespace
+{
+    std::atomic<long long> s_allocations = 0;
+
+    /** Only threads that are inside a CountAllocations scope count their allocations, so
+     * the other benchmarks in the binary only pay for a thread local check */
+    thread_local bool t_countAllocations = false;
+
+    class CountAllocations final
+    {
+    public:
+        CountAllocations() noexcept
+        {
+            t_countAllocations = true;
+        }
+
+        ~CountAllocations()
+        {
+            t_countAllocations = false;
+        }
+
+        CountAllocations(const CountAllocations&) = delete;
+        CountAllocations& operator=(const CountAllocations&) = delete;
+    };
+
+    void* Allocate(std::size_t size)
+    {
+        if (t_countAllocations)
+            s_allocations.fetch_add(1, std::memory_order_relaxed);
+
+        if (const auto memory = std::malloc(size ? size : 1))
+            return memory;
+        throw std::bad_alloc();
+    }
+}
+
+// Replace the allocation functions as pairs, so that everything the replaced operator new
+// allocated is freed by the replaced operator delete, and the other way around
+void* operator new(std::size_t size)
+{
+    return Allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return Allocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+namespace
+{
+    /** The task path ComApartment::Invoke used before: a std::function wrapped in
+     * another std::function, queued as a std::packaged_task */
+    struct StdTasks
+    {
+        using Task = std::packaged_task<long()>;
+
+        template <typename Callable>
+        static std::future<long> Invoke(PriorityTaskDispatcher<Task, ConditionVariableWakeup>& dispatcher, Callable callable)
+        {
+            std::function<long()> func = callable;
+            std::function<long()> hop = [func = std::move(func)] { return func(); };
+            Task task{std::move(hop)};
+            auto future = task.get_future();
+            dispatcher.Submit(TaskPriority::Interactive, std::move(task));
+            return future;
+        }
+
+        static Task Stop()
+        {
+            return Task{[] { return 0L; }};
+        }
+    };
+
+    /** The task path ComApartment::Invoke uses now: a pooled PackagedTask, wrapped in the
+     * small buffer optimized task that is queued for the apartment thread */
+    struct PooledTasks
+    {
+        using Task = SmallFunction<void(bool), 96>;
+
+        template <typename Callable>
+        static TaskFuture<long> Invoke(PriorityTaskDispatcher<Task, ConditionVariableWakeup>& dispatcher, Callable callable)
+        {
+            PackagedTask<long> packaged{[func = std::move(callable)]() mutable { return func(); }};
+            auto future = packaged.get_future();
+
+            auto task = [packaged = std::move(packaged)](bool dropped) mutable {
+                if (dropped)
+                    packaged.skip(0L);
+                else
+                    packaged();
+            };
+            static_assert(Task::StoresInline<decltype(task)>(), "The task should not allocate");
+
+            dispatcher.Submit(TaskPriority::Interactive, Task{std::move(task)});
+            return future;
+        }
+
+        static Task Stop()
+        {
+            return Task{[](bool) {}};
+        }
+    };
+
+    template <typename Task>
+    void Run(Task& task)
+    {
+        if constexpr (std::is_invocable_v<Task&>)
+            task();
+        else
+            task(false);
+    }
+
+    /** Round trip of one task to a consumer thread through the PriorityTaskDispatcher of
+     * ComApartment, with a capture similar to the one ComFactory::CreateInstance uses.
+     * Reports heap allocations per invoke on both threads after warm up. */
+    template <typename Tasks>
+    void BM_InvokeAllocations(benchmark::State& state)
+    {
+        using Task = typename Tasks::Task;
+        PriorityTaskDispatcher<Task, ConditionVariableWakeup> dispatcher{16, QueueLimits{}};
+        std::atomic<bool> stop = false;
+
+        std::thread consumer{[&] {
+            const CountAllocations count;
+            while (!stop)
+            {
+                dispatcher.GetWakeup().Wait();
+                dispatcher.Drain([](Task& task) { Run(task); });
+            }
+        }};
+
+        struct Capture
+        {
+            unsigned char clsid[16];
+            void* outer;
+            void* stream;
+        } capture{};
+
+        const auto invoke = [&] {
+            return Tasks::Invoke(dispatcher, [capture] { return static_cast<long>(capture.clsid[0]); }).get();
+        };
+
+        {
+            const CountAllocations count;
+
+            // Warm up pools and lazily initialized state
+            for (int i = 0; i < 1000; ++i)
+                invoke();
+
+            const auto allocationsBefore = s_allocations.load();
+            for (auto _ : state)
+                benchmark::DoNotOptimize(invoke());
+            const auto allocations = s_allocations.load() - allocationsBefore;
+
+            state.counters["allocs_per_invoke"] = static_cast<double>(allocations) / static_cast<double>(state.iterations());
+        }
+
+        stop = true;
+        dispatcher.Submit(TaskPriority::Interactive, Tasks::Stop());
+        consumer.join();
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_InvokeAllocations, StdTasks)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_InvokeAllocations, PooledTasks)->UseRealTime();
@@ -0,0 +1,128 @@
+#include <ComUtility/CachedAgilePtr.h>
+#include <ComUtility/ComApartment.h>
+#include <ComUtility/ComFactory.h>
+#include <ComUtility/Utility.h>
+#include <Interfaces/IHen.h>
+#include <AtlServer/AtlServer.h>
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <vector>
+#include <wrl.h>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    /** Round trip latency of a call to a ComApartment, from submitting the task until the result is back */
+    void BM_ComApartment_Invoke(benchmark::State& state)
+    {
+        ComApartment apartment;
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(apartment.Invoke([] { return S_OK; }).get());
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    /** One-way traffic: a batch of tasks whose results are not needed, followed by one call
+     * that waits for the batch to finish. Post skips the shared state of the future. */
+    template <bool UsePost>
+    void BM_ComApartment_OneWay(benchmark::State& state)
+    {
+        ComApartment apartment;
+        const auto batchSize = state.range(0);
+
+        for (auto _ : state)
+        {
+            for (int64_t i = 0; i < batchSize; ++i)
+            {
+                if constexpr (UsePost)
+                    apartment.Post([] { return S_OK; });
+                else
+                    apartment.Invoke([] { return S_OK; });
+            }
+            HR(apartment.Invoke([] { return S_OK; }).get());
+        }
+
+        state.SetItemsProcessed(state.iterations() * batchSize);
+        state.SetLabel(UsePost ? "Post" : "Invoke");
+    }
+
+    /** Time to destroy a batch of idle apartments, as when apartments are recreated during
+     * reconfiguration. Creating the apartments is not measured. */
+    void BM_ComApartment_Shutdown(benchmark::State& state)
+    {
+        const auto count = static_cast<size_t>(state.range(0));
+
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            std::vector<std::unique_ptr<ComApartment>> apartments;
+            for (size_t i = 0; i < count; ++i)
+                apartments.push_back(std::make_unique<ComApartment>());
+            state.ResumeTiming();
+
+            apartments.clear();
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    /** Cost of resolving an agile reference into a proxy on the calling thread */
+    void BM_AgilePtr_Get(benchmark::State& state)
+    {
+        ComRuntime runtime{Apartment::MultiThreaded};
+        ComFactory factory;
+        ComPtr<IHen> hen;
+        HR(factory.CreateInstance(__uuidof(AtlHen), nullptr, __uuidof(IHen), reinterpret_cast<void**>(hen.GetAddressOf())));
+        const AgilePtr<IHen> agile{hen.Get()};
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(agile.Get());
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    /** Like BM_AgilePtr_Get, but the proxy is resolved once and then taken from the cache of the thread */
+    void BM_CachedAgilePtr_Get(benchmark::State& state)
+    {
+        ComRuntime runtime{Apartment::MultiThreaded};
+        ComFactory factory;
+        ComPtr<IHen> hen;
+        HR(factory.CreateInstance(__uuidof(AtlHen), nullptr, __uuidof(IHen), reinterpret_cast<void**>(hen.GetAddressOf())));
+        const CachedAgilePtr<IHen> agile{hen.Get()};
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(agile.Get());
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    /** Baseline from WRL, which resolves an IAgileReference with each call to As */
+    void BM_AgileRef_As(benchmark::State& state)
+    {
+        ComRuntime runtime{Apartment::MultiThreaded};
+        ComFactory factory;
+        ComPtr<IHen> hen;
+        HR(factory.CreateInstance(__uuidof(AtlHen), nullptr, __uuidof(IHen), reinterpret_cast<void**>(hen.GetAddressOf())));
+        Microsoft::WRL::AgileRef agile;
+        HR(hen.AsAgile(&agile));
+
+        for (auto _ : state)
+        {
+            ComPtr<IHen> resolved;
+            HR(agile.As(&resolved));
+            benchmark::DoNotOptimize(resolved);
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+}
+
+BENCHMARK(BM_ComApartment_Invoke)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ComApartment_OneWay, false)->Arg(1000)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ComApartment_OneWay, true)->Arg(1000)->UseRealTime();
+BENCHMARK(BM_ComApartment_Shutdown)->Arg(100)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_AgilePtr_Get)->UseRealTime();
+BENCHMARK(BM_CachedAgilePtr_Get)->UseRealTime();
+BENCHMARK(BM_AgileRef_As)->UseRealTime();
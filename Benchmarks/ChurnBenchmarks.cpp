@@ -0,0 +1,76 @@
+#include <ComUtility/ObjectPool.h>
+#include <benchmark/benchmark.h>
+#include <array>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    /** Stand-in for GuardDog in AtlFreeServer: a vtable and a reference count */
+    struct Dog
+    {
+        virtual ~Dog() = default;
+        virtual long Sit()
+        {
+            return m_count;
+        }
+
+        long m_count = 0;
+    };
+
+    /** Dogs from the global heap. Goes through malloc, since AllocationBenchmarks.cpp replaces
+     * operator new with a version that counts allocations on a shared counter. */
+    struct HeapDogs
+    {
+        static Dog* Create()
+        {
+            const auto memory = std::malloc(sizeof(Dog));
+            return memory ? new (memory) Dog : nullptr;
+        }
+
+        static void Destroy(Dog* dog)
+        {
+            dog->~Dog();
+            std::free(dog);
+        }
+    };
+
+    /** Dogs from ObjectPool, like PuppyFarm creates them */
+    struct PooledDogs
+    {
+        static Dog* Create()
+        {
+            const auto memory = ObjectPool<Dog>::Allocate();
+            return memory ? new (memory) Dog : nullptr;
+        }
+
+        static void Destroy(Dog* dog)
+        {
+            ObjectPool<Dog>::Delete(dog);
+        }
+    };
+
+    /** Create and release batches of objects on every thread, as when many clients
+     * create short lived objects on a server */
+    template <typename Dogs>
+    void BM_ObjectChurn(benchmark::State& state)
+    {
+        std::array<Dog*, 32> dogs{};
+
+        for (auto _ : state)
+        {
+            for (auto& dog : dogs)
+                dog = Dogs::Create();
+            for (const auto dog : dogs)
+            {
+                benchmark::DoNotOptimize(dog->Sit());
+                Dogs::Destroy(dog);
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(dogs.size()));
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_ObjectChurn, HeapDogs)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ObjectChurn, PooledDogs)->ThreadRange(1, 16)->UseRealTime();
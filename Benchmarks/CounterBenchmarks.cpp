@@ -0,0 +1,48 @@
+#include <ComUtility/ShardedCounter.h>
+#include <benchmark/benchmark.h>
+#include <atomic>
+
+namespace
+{
+    /** Portable stand-in for the global long that AtlFreeServer updated with
+     * _InterlockedIncrement and _InterlockedDecrement */
+    struct InterlockedCounter
+    {
+        void Increment() noexcept
+        {
+            m_count.fetch_add(1);
+        }
+
+        void Decrement() noexcept
+        {
+            m_count.fetch_sub(1);
+        }
+
+        int64_t Count() const noexcept
+        {
+            return m_count.load();
+        }
+
+        std::atomic<long> m_count = 0;
+    };
+
+    /** Every thread creates and releases objects that each lock the server while they are alive */
+    template <typename Counter>
+    void BM_ServerLock_Contention(benchmark::State& state)
+    {
+        static Counter counter;
+
+        for (auto _ : state)
+        {
+            counter.Increment();
+            counter.Decrement();
+        }
+
+        if (state.thread_index() == 0)
+            benchmark::DoNotOptimize(counter.Count());
+        state.SetItemsProcessed(state.iterations());
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_ServerLock_Contention, InterlockedCounter)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ServerLock_Contention, ShardedCounter)->ThreadRange(1, 16)->UseRealTime();
@@ -0,0 +1,98 @@
+#include <ComUtility/PriorityTaskDispatcher.h>
+#include <ComUtility/ThreadSafeQueue.h>
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+namespace
+{
+    using Task = std::function<void()>;
+
+    /** Wake up the consumer for every task, like ComApartment used to post one message per task */
+    class WakeupPerTask
+    {
+    public:
+        void Submit(Task task)
+        {
+            m_queue.push_back(std::move(task));
+            m_wakeup.Signal();
+        }
+
+        void Serve()
+        {
+            m_wakeup.Wait();
+            while (!m_queue.empty())
+                m_queue.pop_front()();
+        }
+
+        size_t SignalCount()
+        {
+            return m_wakeup.SignalCount();
+        }
+
+    private:
+        ThreadSafeQueue<Task> m_queue;
+        ConditionVariableWakeup m_wakeup;
+    };
+
+    /** Coalesce wakeups and drain all tasks per wakeup */
+    class CoalescedWakeup
+    {
+    public:
+        void Submit(Task task)
+        {
+            m_dispatcher.Submit(TaskPriority::Interactive, std::move(task));
+        }
+
+        void Serve()
+        {
+            m_dispatcher.GetWakeup().Wait();
+            m_dispatcher.Drain([](Task& task) { task(); });
+        }
+
+        size_t SignalCount()
+        {
+            return m_dispatcher.GetWakeup().SignalCount();
+        }
+
+    private:
+        PriorityTaskDispatcher<Task, ConditionVariableWakeup> m_dispatcher{16, QueueLimits{}};
+    };
+
+    /** A burst of tasks sent from one producer to a consumer thread that waits for wakeups */
+    template <typename Dispatcher>
+    void BM_TaskBurst(benchmark::State& state)
+    {
+        const auto burstSize = static_cast<int>(state.range(0));
+        Dispatcher dispatcher;
+        std::atomic<bool> stop = false;
+        std::atomic<int> executed = 0;
+
+        std::thread consumer{[&] {
+            while (!stop)
+                dispatcher.Serve();
+        }};
+
+        for (auto _ : state)
+        {
+            executed = 0;
+            for (int i = 0; i < burstSize; ++i)
+                dispatcher.Submit([&] { executed.fetch_add(1, std::memory_order_relaxed); });
+
+            while (executed != burstSize)
+                std::this_thread::yield();
+        }
+
+        const auto tasks = state.iterations() * burstSize;
+        state.SetItemsProcessed(tasks);
+        state.counters["wakeups_per_task"] = static_cast<double>(dispatcher.SignalCount()) / static_cast<double>(tasks);
+
+        stop = true;
+        dispatcher.Submit([] {});
+        consumer.join();
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_TaskBurst, WakeupPerTask)->RangeMultiplier(10)->Range(1, 10000)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_TaskBurst, CoalescedWakeup)->RangeMultiplier(10)->Range(1, 10000)->UseRealTime();
@@ -0,0 +1,152 @@
+#include <ComUtility/ComFactory.h>
+#include <ComUtility/Utility.h>
+#include <Interfaces/IHen.h>
+#include <AtlServer/AtlServer.h>
+#include <benchmark/benchmark.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    /** Create a batch of objects with one CreateInstance call per object */
+    void BM_CreateInstance_PerObject(benchmark::State& state)
+    {
+        ComRuntime runtime{Apartment::MultiThreaded};
+        ComFactory factory;
+        std::vector<IHen*> hens(static_cast<size_t>(state.range(0)));
+
+        for (auto _ : state)
+        {
+            for (auto& hen : hens)
+                HR(factory.CreateInstance(__uuidof(AtlHen), nullptr, __uuidof(IHen), reinterpret_cast<void**>(&hen)));
+
+            state.PauseTiming();
+            for (const auto hen : hens)
+                hen->Release();
+            state.ResumeTiming();
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    /** Objects created per second by several calling threads that share a factory with
+     * a pool of apartments */
+    void BM_CreateInstance_Throughput(benchmark::State& state)
+    {
+        constexpr int ObjectsPerCaller = 100;
+        const auto callerCount = static_cast<int>(state.range(0));
+        ComFactory factory{ApartmentPoolOptions{4, 4, Placement::LeastQueueDepth}};
+
+        for (auto _ : state)
+        {
+            std::vector<std::thread> callers;
+            for (int caller = 0; caller < callerCount; ++caller)
+            {
+                callers.emplace_back([&factory] {
+                    ComRuntime runtime{Apartment::MultiThreaded};
+                    for (int i = 0; i < ObjectsPerCaller; ++i)
+                    {
+                        IHen* hen = nullptr;
+                        HR(factory.CreateInstance(__uuidof(AtlHen), nullptr, __uuidof(IHen), reinterpret_cast<void**>(&hen)));
+                        hen->Release();
+                    }
+                });
+            }
+
+            for (auto& caller : callers)
+                caller.join();
+        }
+
+        state.SetItemsProcessed(state.iterations() * callerCount * ObjectsPerCaller);
+    }
+
+    /** Create one object at a time, with the class factory cached from the previous iteration,
+     * or looked up again through CoGetClassObject */
+    void BM_CreateInstance_ClassFactory(benchmark::State& state)
+    {
+        const auto cached = state.range(0) != 0;
+        ComRuntime runtime{Apartment::MultiThreaded};
+        ComFactory factory;
+
+        for (auto _ : state)
+        {
+            IHen* hen = nullptr;
+            HR(factory.CreateInstance(__uuidof(AtlHen), nullptr, __uuidof(IHen), reinterpret_cast<void**>(&hen)));
+
+            state.PauseTiming();
+            hen->Release();
+            if (!cached)
+                HR(factory.InvalidateClassFactory(__uuidof(AtlHen)));
+            state.ResumeTiming();
+        }
+
+        state.SetLabel(cached ? "cached" : "uncached");
+    }
+
+    /** Create a batch of objects with a single apartment hop */
+    void BM_CreateInstances_Batched(benchmark::State& state)
+    {
+        ComRuntime runtime{Apartment::MultiThreaded};
+        ComFactory factory;
+        std::vector<IHen*> hens(static_cast<size_t>(state.range(0)));
+
+        for (auto _ : state)
+        {
+            HR(factory.CreateInstances(__uuidof(AtlHen), __uuidof(IHen), hens.size(), reinterpret_cast<void**>(hens.data())));
+
+            state.PauseTiming();
+            for (const auto hen : hens)
+                hen->Release();
+            state.ResumeTiming();
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    /** A pool of worker threads that each make calls on an object. Either every worker
+     * creates its own object, or all workers share one object through a SharedInstance. */
+    void BM_SharedInstance_Workers(benchmark::State& state)
+    {
+        constexpr int WorkerCount = 32;
+        constexpr int CallsPerWorker = 10;
+        const auto shared = state.range(0) != 0;
+        ComRuntime runtime{Apartment::MultiThreaded};
+        ComFactory factory;
+
+        for (auto _ : state)
+        {
+            SharedInstance instance;
+            if (shared)
+                HR(factory.CreateSharedInstance(__uuidof(AtlHen), __uuidof(IHen), instance));
+
+            std::vector<std::thread> workers;
+            for (int worker = 0; worker < WorkerCount; ++worker)
+            {
+                workers.emplace_back([&factory, &instance, shared] {
+                    ComRuntime workerRuntime{Apartment::MultiThreaded};
+                    IHen* hen = nullptr;
+                    if (shared)
+                        HR(instance.Get(&hen));
+                    else
+                        HR(factory.CreateInstance(__uuidof(AtlHen), nullptr, __uuidof(IHen), reinterpret_cast<void**>(&hen)));
+
+                    for (int i = 0; i < CallsPerWorker; ++i)
+                        HR(hen->Cluck());
+                    hen->Release();
+                });
+            }
+
+            for (auto& worker : workers)
+                worker.join();
+        }
+
+        state.SetItemsProcessed(state.iterations() * WorkerCount);
+        state.SetLabel(shared ? "shared" : "per worker");
+    }
+}
+
+BENCHMARK(BM_CreateInstance_PerObject)->RangeMultiplier(10)->Range(1, 1000)->UseRealTime();
+BENCHMARK(BM_CreateInstance_Throughput)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+BENCHMARK(BM_CreateInstance_ClassFactory)->Arg(0)->Arg(1)->UseRealTime();
+BENCHMARK(BM_CreateInstances_Batched)->RangeMultiplier(10)->Range(1, 1000)->UseRealTime();
+BENCHMARK(BM_SharedInstance_Workers)->Arg(0)->Arg(1)->UseRealTime();
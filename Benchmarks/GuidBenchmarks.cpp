@@ -0,0 +1,75 @@
+#include <ComUtility/GuidTable.h>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr size_t ClassCount = 512;
+
+    /** Random GUIDs, like the CLSIDs of the classes of a dll */
+    std::vector<GuidValue> CreateClsids()
+    {
+        std::mt19937_64 random{42};
+        std::vector<GuidValue> clsids(ClassCount);
+        for (auto& clsid : clsids)
+        {
+            const auto high = random();
+            const auto low = random();
+            clsid.data1 = static_cast<uint32_t>(high >> 32);
+            clsid.data2 = static_cast<uint16_t>(high >> 16);
+            clsid.data3 = static_cast<uint16_t>(high);
+            for (size_t i = 0; i < clsid.data4.size(); ++i)
+                clsid.data4[i] = static_cast<uint8_t>(low >> (8 * i));
+        }
+        return clsids;
+    }
+
+    /** Compare with every CLSID in turn, which is what an if chain in DllGetClassObject does */
+    void BM_ClsidLookup_IfChain(benchmark::State& state)
+    {
+        const auto clsids = CreateClsids();
+        size_t next = 0;
+
+        for (auto _ : state)
+        {
+            const auto& clsid = clsids[next++ % ClassCount];
+            size_t found = ClassCount;
+            for (size_t i = 0; i < ClassCount; ++i)
+            {
+                if (clsids[i] == clsid)
+                {
+                    found = i;
+                    break;
+                }
+            }
+            benchmark::DoNotOptimize(found);
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    /** Binary search in a GuidTable */
+    void BM_ClsidLookup_GuidTable(benchmark::State& state)
+    {
+        const auto clsids = CreateClsids();
+        GuidTableEntry<size_t> entries[ClassCount]{};
+        for (size_t i = 0; i < ClassCount; ++i)
+            entries[i] = {clsids[i], i};
+        const auto table = std::make_unique<GuidTable<size_t, ClassCount>>(entries);
+        size_t next = 0;
+
+        for (auto _ : state)
+        {
+            const auto found = table->Find(clsids[next++ % ClassCount]);
+            benchmark::DoNotOptimize(found);
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+}
+
+BENCHMARK(BM_ClsidLookup_IfChain);
+BENCHMARK(BM_ClsidLookup_GuidTable);
@@ -0,0 +1,146 @@
+#include <ComUtility/Utility.h>
+#include <Interfaces/IHen.h>
+#include <AtlServer/AtlServer.h>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <TlHelp32.h>
+#include <wrl.h>
+
+using Microsoft::WRL::ClassicCom;
+using Microsoft::WRL::FtmBase;
+using Microsoft::WRL::Make;
+using Microsoft::WRL::RuntimeClass;
+using Microsoft::WRL::RuntimeClassFlags;
+
+namespace
+{
+    /** Observer that can be called from any thread, and signals when it has been called a given number of times */
+    class CountingObserver final : public RuntimeClass<RuntimeClassFlags<ClassicCom>, FtmBase, IAsyncCluckObserver>
+    {
+    public:
+        void Expect(long count)
+        {
+            std::lock_guard guard(m_mutex);
+            m_remaining = count;
+        }
+
+        void Wait()
+        {
+            std::unique_lock lock(m_mutex);
+            m_done.wait(lock, [this] { return m_remaining == 0; });
+        }
+
+        STDMETHODIMP OnCluck() override
+        {
+            std::lock_guard guard(m_mutex);
+            if (--m_remaining == 0)
+                m_done.notify_all();
+            return S_OK;
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_done;
+        long m_remaining = 0;
+    };
+
+    size_t ThreadCountOfThisProcess()
+    {
+        const auto snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+        if (snapshot == INVALID_HANDLE_VALUE)
+            return 0;
+
+        size_t count = 0;
+        THREADENTRY32 entry{};
+        entry.dwSize = sizeof(entry);
+        for (auto found = Thread32First(snapshot, &entry); found; found = Thread32Next(snapshot, &entry))
+        {
+            if (entry.th32OwnerProcessID == GetCurrentProcessId())
+                ++count;
+        }
+
+        CloseHandle(snapshot);
+        return count;
+    }
+
+    /** 10000 CluckAsync calls from 8 threads at once, until all observers have been called.
+     * The threads counter is the number of threads in the process when the calls have been made. */
+    void BM_FreeThreadedHen_CluckAsync(benchmark::State& state)
+    {
+        constexpr long CallCount = 10000;
+        constexpr long CallerCount = 8;
+        ComRuntime runtime{Apartment::MultiThreaded};
+        CComPtr<IHen> hen;
+        HR(CoCreateInstance(__uuidof(FreeThreadedHen), nullptr, CLSCTX_INPROC_SERVER, __uuidof(IHen), reinterpret_cast<void**>(&hen)));
+        const auto observer = Make<CountingObserver>();
+        size_t threadCount = 0;
+
+        for (auto _ : state)
+        {
+            observer->Expect(CallCount);
+
+            std::vector<std::thread> callers;
+            for (long caller = 0; caller < CallerCount; ++caller)
+            {
+                callers.emplace_back([&hen, &observer] {
+                    ComRuntime callerRuntime{Apartment::MultiThreaded};
+                    for (long i = 0; i < CallCount / CallerCount; ++i)
+                        HR(hen->CluckAsync(observer.Get()));
+                });
+            }
+            for (auto& caller : callers)
+                caller.join();
+
+            threadCount = std::max(threadCount, ThreadCountOfThisProcess());
+            observer->Wait();
+        }
+
+        state.SetItemsProcessed(state.iterations() * CallCount);
+        state.counters["threads"] = static_cast<double>(threadCount);
+    }
+
+    /** One cluck that notifies range(0) subscribed observers, compared to one CluckAsync call per observer */
+    void BM_SubscriptionHen_Cluck(benchmark::State& state)
+    {
+        const auto observerCount = static_cast<long>(state.range(0));
+        const auto subscribed = state.range(1) != 0;
+        ComRuntime runtime{Apartment::MultiThreaded};
+        CComPtr<ISubscribableHen> hen;
+        HR(CoCreateInstance(__uuidof(SubscriptionHen), nullptr, CLSCTX_INPROC_SERVER, __uuidof(ISubscribableHen), reinterpret_cast<void**>(&hen)));
+        const auto observer = Make<CountingObserver>();
+
+        if (subscribed)
+        {
+            for (long i = 0; i < observerCount; ++i)
+            {
+                unsigned long cookie = 0;
+                HR(hen->Subscribe(observer.Get(), &cookie));
+            }
+        }
+
+        for (auto _ : state)
+        {
+            observer->Expect(observerCount);
+            if (subscribed)
+            {
+                HR(hen->Cluck());
+            }
+            else
+            {
+                for (long i = 0; i < observerCount; ++i)
+                    HR(hen->CluckAsync(observer.Get()));
+            }
+            observer->Wait();
+        }
+
+        state.SetItemsProcessed(state.iterations() * observerCount);
+        state.SetLabel(subscribed ? "Subscribe" : "CluckAsync");
+    }
+}
+
+BENCHMARK(BM_FreeThreadedHen_CluckAsync)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_SubscriptionHen_Cluck)->ArgsProduct({{64, 1024}, {0, 1}})->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,33 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/** Same as BENCHMARK_MAIN, but the results are also written as JSON to
+ * benchmark_results.json, unless --benchmark_out is given on the command line.
+ * This lets the build farm collect the results without extra arguments. */
+int main(int argc, char** argv)
+{
+    std::vector<char*> arguments(argv, argv + argc);
+
+    std::string out = "--benchmark_out=benchmark_results.json";
+    std::string format = "--benchmark_out_format=json";
+    const auto hasOut = std::any_of(arguments.begin(), arguments.end(), [](const char* argument) {
+        return std::strncmp(argument, "--benchmark_out=", std::strlen("--benchmark_out=")) == 0;
+    });
+    if (!hasOut)
+    {
+        arguments.push_back(out.data());
+        arguments.push_back(format.data());
+    }
+
+    auto count = static_cast<int>(arguments.size());
+    benchmark::Initialize(&count, arguments.data());
+    if (benchmark::ReportUnrecognizedArguments(count, arguments.data()))
+        return 1;
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
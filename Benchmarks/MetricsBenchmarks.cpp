@@ -0,0 +1,123 @@
+#include <ComUtility/PriorityTaskDispatcher.h>
+#include <ComUtility/SmallFunction.h>
+#include <ComUtility/TaskFuture.h>
+#include <ComUtility/TaskMetrics.h>
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <stop_token>
+#include <thread>
+
+namespace
+{
+    using Task = SmallFunction<void(bool), 96>;
+
+    /** Same fields as the queued task of ComApartment */
+    struct QueuedTask
+    {
+        Task task;
+        TaskMetrics::Clock::time_point queuedAt;
+        TaskMetrics::Clock::time_point deadline;
+        std::stop_token cancellation;
+    };
+
+    /** Consumer thread that queues and runs tasks the same way as ComApartment, with a
+     * PriorityTaskDispatcher and the checks for cancelled and expired tasks, with or
+     * without recording metrics */
+    template <bool RecordMetrics>
+    class Worker
+    {
+    public:
+        Worker() : m_thread([this] { Run(); }) {}
+
+        ~Worker()
+        {
+            Invoke([this] {
+                m_stop = true;
+                return 0L;
+            }).get();
+            m_thread.join();
+        }
+
+        TaskFuture<long> Invoke(PackagedTask<long>::Callable callable)
+        {
+            PackagedTask<long> packaged{std::move(callable)};
+            auto future = packaged.get_future();
+            Task task{[packaged = std::move(packaged)](bool dropped) mutable {
+                if (dropped)
+                    packaged.skip(0L);
+                else
+                    packaged();
+            }};
+
+            if constexpr (RecordMetrics)
+                m_metrics.RecordSubmitted();
+            const auto queuedAt = RecordMetrics ? TaskMetrics::Clock::now() : TaskMetrics::Clock::time_point{};
+            m_tasks.Submit(TaskPriority::Interactive, QueuedTask{std::move(task), queuedAt, TaskMetrics::Clock::time_point::max(), {}});
+            return future;
+        }
+
+    private:
+        void Run()
+        {
+            while (!m_stop)
+            {
+                m_tasks.GetWakeup().Wait();
+                m_tasks.Drain([this](QueuedTask& queued) {
+                    // The deadline check needs the start time with or without metrics
+                    const auto started = TaskMetrics::Clock::now();
+                    const auto dropped = queued.cancellation.stop_requested() || started > queued.deadline;
+                    queued.task(dropped);
+
+                    if constexpr (RecordMetrics)
+                    {
+                        if (dropped)
+                            m_metrics.RecordDropped();
+                        else
+                            m_metrics.RecordCompleted(queued.queuedAt, started, TaskMetrics::Clock::now());
+                    }
+                });
+            }
+        }
+
+        PriorityTaskDispatcher<QueuedTask, ConditionVariableWakeup> m_tasks{16, QueueLimits{}};
+        TaskMetrics m_metrics;
+        bool m_stop = false;    ///< Only used on the worker thread
+        std::thread m_thread;
+    };
+
+    /** Round trip of a task to a worker thread and back, which is what a call to
+     * ComApartment::Invoke costs apart from the Windows message queue */
+    template <bool RecordMetrics>
+    void BM_InvokeRoundTrip(benchmark::State& state)
+    {
+        Worker<RecordMetrics> worker;
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(worker.Invoke([] { return 42L; }).get());
+
+        state.SetItemsProcessed(state.iterations());
+        state.SetLabel(RecordMetrics ? "metrics" : "no metrics");
+    }
+
+    /** The work metrics add to each task on one thread: two extra clock reads and the
+     * counters and histograms, without the noise of the thread hop */
+    void BM_RecordTask(benchmark::State& state)
+    {
+        TaskMetrics metrics;
+
+        for (auto _ : state)
+        {
+            const auto queuedAt = TaskMetrics::Clock::now();
+            metrics.RecordSubmitted();
+            const auto started = TaskMetrics::Clock::now(); // Taken for the deadline check anyway
+            metrics.RecordCompleted(queuedAt, started, TaskMetrics::Clock::now());
+        }
+
+        benchmark::DoNotOptimize(metrics.GetSnapshot(0));
+        state.SetItemsProcessed(state.iterations());
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_InvokeRoundTrip, false)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_InvokeRoundTrip, true)->UseRealTime();
+BENCHMARK(BM_RecordTask);
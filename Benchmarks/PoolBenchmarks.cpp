@@ -0,0 +1,88 @@
+#include <ComUtility/WorkStealingPool.h>
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr int TasksPerIteration = 1024;
+
+    /** A small amount of CPU work, so that the benchmarks measure scheduling as well as scaling */
+    void Work()
+    {
+        unsigned value = 0;
+        for (unsigned i = 0; i < 2000; ++i)
+            benchmark::DoNotOptimize(value += i * i);
+    }
+
+    void WaitFor(const std::atomic<int>& remaining)
+    {
+        while (remaining.load(std::memory_order_acquire) != 0)
+            std::this_thread::yield();
+    }
+
+    /** Independent tasks submitted from a thread outside the pool */
+    void BM_WorkStealingPool_Independent(benchmark::State& state)
+    {
+        WorkStealingPool<> pool{static_cast<size_t>(state.range(0))};
+
+        for (auto _ : state)
+        {
+            std::vector<TaskFuture<void>> futures;
+            futures.reserve(TasksPerIteration);
+            for (int i = 0; i < TasksPerIteration; ++i)
+                futures.push_back(pool.Submit(Work));
+
+            for (auto& future : futures)
+                future.get();
+        }
+
+        state.SetItemsProcessed(state.iterations() * TasksPerIteration);
+    }
+
+    /** A root task fans out children from a worker, so other workers must steal to help out */
+    void BM_WorkStealingPool_ForkJoin(benchmark::State& state)
+    {
+        WorkStealingPool<> pool{static_cast<size_t>(state.range(0))};
+
+        for (auto _ : state)
+        {
+            std::atomic<int> remaining = TasksPerIteration;
+            pool.Submit([&] {
+                for (int i = 0; i < TasksPerIteration; ++i)
+                {
+                    pool.Submit([&] {
+                        Work();
+                        remaining.fetch_sub(1, std::memory_order_release);
+                    });
+                }
+            });
+            WaitFor(remaining);
+        }
+
+        state.SetItemsProcessed(state.iterations() * TasksPerIteration);
+    }
+
+    /** Baseline: one std::async thread per task, like FreeThreadedHen::CluckAsync used to do */
+    void BM_StdAsync_Independent(benchmark::State& state)
+    {
+        for (auto _ : state)
+        {
+            std::vector<std::future<void>> futures;
+            futures.reserve(TasksPerIteration);
+            for (int i = 0; i < TasksPerIteration; ++i)
+                futures.push_back(std::async(std::launch::async, Work));
+
+            for (auto& future : futures)
+                future.get();
+        }
+
+        state.SetItemsProcessed(state.iterations() * TasksPerIteration);
+    }
+}
+
+BENCHMARK(BM_WorkStealingPool_Independent)->RangeMultiplier(2)->Range(1, 64)->UseRealTime();
+BENCHMARK(BM_WorkStealingPool_ForkJoin)->RangeMultiplier(2)->Range(1, 64)->UseRealTime();
+BENCHMARK(BM_StdAsync_Independent)->UseRealTime();
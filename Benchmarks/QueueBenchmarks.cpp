@@ -0,0 +1,83 @@
+#include <ComUtility/MpscQueue.h>
+#include <ComUtility/ThreadSafeQueue.h>
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr int ElementsPerProducer = 100000;
+
+    /** Drain with the single consumer pattern used by ComApartment before the MpscQueue */
+    int Drain(ThreadSafeQueue<int>& queue)
+    {
+        int consumed = 0;
+        while (!queue.empty())
+        {
+            benchmark::DoNotOptimize(queue.pop_front());
+            ++consumed;
+        }
+        return consumed;
+    }
+
+    int Drain(MpscQueue<int>& queue)
+    {
+        return static_cast<int>(queue.consume_all([](int value) {
+            benchmark::DoNotOptimize(value);
+        }));
+    }
+
+    /** Every thread pushes and pops on the same queue, so all operations contend for its lock */
+    void BM_ThreadSafeQueue_PushPop(benchmark::State& state)
+    {
+        static ThreadSafeQueue<int> queue;
+
+        // Each thread pops after its own push, so the queue is never empty when popped
+        for (auto _ : state)
+        {
+            queue.push_back(state.thread_index());
+            benchmark::DoNotOptimize(queue.pop_front());
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    /** Many producers push into one queue while a single consumer drains it,
+     * which is the access pattern of threads sending work to one apartment */
+    template <typename Queue>
+    void BM_ProducersToSingleConsumer(benchmark::State& state)
+    {
+        const auto producerCount = static_cast<int>(state.range(0));
+
+        for (auto _ : state)
+        {
+            Queue queue;
+            std::atomic<bool> start = false;
+            std::vector<std::thread> producers;
+            for (int producer = 0; producer < producerCount; ++producer)
+            {
+                producers.emplace_back([&] {
+                    while (!start)
+                        std::this_thread::yield();
+                    for (int i = 0; i < ElementsPerProducer; ++i)
+                        queue.push_back(i);
+                });
+            }
+
+            start = true;
+            int consumed = 0;
+            while (consumed < producerCount * ElementsPerProducer)
+                consumed += Drain(queue);
+
+            for (auto& producer : producers)
+                producer.join();
+        }
+
+        state.SetItemsProcessed(state.iterations() * producerCount * ElementsPerProducer);
+    }
+}
+
+BENCHMARK(BM_ThreadSafeQueue_PushPop)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ProducersToSingleConsumer, ThreadSafeQueue<int>)->RangeMultiplier(2)->Range(1, 32)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ProducersToSingleConsumer, MpscQueue<int>)->RangeMultiplier(2)->Range(1, 32)->UseRealTime();
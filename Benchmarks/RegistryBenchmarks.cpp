@@ -0,0 +1,98 @@
+#include <ComUtility/RegistryBackend.h>
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Entry
+    {
+        std::wstring path;
+        std::wstring name;
+        std::wstring value;
+    };
+
+    /** Table with the four entries that AtlFreeServer registers for each class */
+    std::vector<Entry> CreateTable(size_t classCount)
+    {
+        std::vector<Entry> table;
+        for (size_t i = 0; i < classCount; ++i)
+        {
+            wchar_t clsid[64]{};
+            std::swprintf(clsid, 64, L"{%08zx-cdf4-44bc-8018-6058420bcfdc}", i);
+            const auto classKey = L"Software\\Classes\\CLSID\\" + std::wstring{clsid};
+            table.push_back({classKey, L"", L"COM class"});
+            table.push_back({classKey, L"AppID", L"{2b083fea-3681-4c9b-9ed1-3e866124a58d}"});
+            table.push_back({classKey + L"\\InprocServer32", L"", L"C:\\AtlFreeServer.dll"});
+            table.push_back({classKey + L"\\InprocServer32", L"ThreadingModel", L"Free"});
+        }
+        return table;
+    }
+
+    /** One WriteKey per entry, which is how Register used to open a key for every value */
+    void BM_Register_PerEntry(benchmark::State& state)
+    {
+        const auto table = CreateTable(static_cast<size_t>(state.range(0)));
+        size_t writes = 0;
+
+        for (auto _ : state)
+        {
+            MemoryRegistry registry;
+            for (const auto& entry : table)
+                registry.WriteKey({entry.path, {{entry.name, entry.value}}});
+            writes = registry.WriteCount();
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+        state.counters["key_opens"] = static_cast<double>(writes);
+    }
+
+    /** Entries grouped by key with RegistryBatch, so that each key is opened once */
+    void BM_Register_Batched(benchmark::State& state)
+    {
+        const auto table = CreateTable(static_cast<size_t>(state.range(0)));
+        size_t writes = 0;
+
+        for (auto _ : state)
+        {
+            MemoryRegistry registry;
+            RegistryBatch batch;
+            for (const auto& entry : table)
+                batch.SetValue(entry.path, entry.name, entry.value);
+            batch.Write(registry);
+            writes = registry.WriteCount();
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+        state.counters["key_opens"] = static_cast<double>(writes);
+    }
+
+    /** Unregister all classes from a registry where they are registered */
+    void BM_Unregister_Batched(benchmark::State& state)
+    {
+        const auto table = CreateTable(static_cast<size_t>(state.range(0)));
+        RegistryBatch batch;
+        for (const auto& entry : table)
+        {
+            batch.DeleteTree(entry.path);
+            batch.SetValue(entry.path, entry.name, entry.value);
+        }
+
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            MemoryRegistry registry;
+            batch.Write(registry);
+            state.ResumeTiming();
+
+            batch.Delete(registry);
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+}
+
+BENCHMARK(BM_Register_PerEntry)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Register_Batched)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Unregister_Batched)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,150 @@
+#include "pch.h"
+#include "Include/ComUtility/CachedAgilePtr.h"
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <wrl.h>
+
+using Microsoft::WRL::ClassicCom;
+using Microsoft::WRL::ComPtr;
+using Microsoft::WRL::Make;
+using Microsoft::WRL::RuntimeClass;
+using Microsoft::WRL::RuntimeClassFlags;
+
+namespace
+{
+    struct Entry
+    {
+        uint64_t id;
+        std::weak_ptr<void> owner;
+        CComPtr<IUnknown> resolved;
+    };
+
+    /** Empties the cache of its thread when the thread leaves COM */
+    class UninitializeSpy final : public RuntimeClass<RuntimeClassFlags<ClassicCom>, IInitializeSpy>
+    {
+    public:
+        explicit UninitializeSpy(std::vector<Entry>& entries) : m_entries(entries) {}
+
+        STDMETHODIMP PreInitialize(DWORD, DWORD) override
+        {
+            return S_OK;
+        }
+
+        STDMETHODIMP PostInitialize(HRESULT result, DWORD, DWORD) override
+        {
+            return result;
+        }
+
+        /** Called before CoUninitialize. With one apartment reference left, this is the last
+         * chance to release the proxies in the apartment that created them. */
+        STDMETHODIMP PreUninitialize(DWORD currentApartmentReferences) override
+        {
+            if (currentApartmentReferences == 1)
+                m_entries.clear();
+            return S_OK;
+        }
+
+        STDMETHODIMP PostUninitialize(DWORD) override
+        {
+            return S_OK;
+        }
+
+    private:
+        std::vector<Entry>& m_entries;
+    };
+
+    /** The cache of one thread. The spy is registered when the first entry is inserted. */
+    class ThreadCache final
+    {
+    public:
+        ~ThreadCache()
+        {
+            m_entries.clear();
+            if (m_spy)
+                CoRevokeInitializeSpy(m_cookie);
+        }
+
+        IUnknown* Find(uint64_t id)
+        {
+            ReleaseExpired();
+
+            // Linear search, since a thread typically uses a handful of agile references
+            const auto entry = std::find_if(m_entries.begin(), m_entries.end(), [id](const Entry& e) {
+                return e.id == id;
+            });
+            return entry == m_entries.end() ? nullptr : entry->resolved.p;
+        }
+
+        void Insert(uint64_t id, const std::shared_ptr<void>& owner, IUnknown* resolved)
+        {
+            // Without the spy, proxies would outlive the apartment of the thread. Then it is
+            // better to not cache at all.
+            if (!RegisterSpy())
+                return;
+
+            ReleaseExpired();
+            m_entries.push_back(Entry{id, owner, resolved});
+        }
+
+    private:
+        /** Release proxies to objects whose agile references are gone, so that the cache
+         * does not keep the objects alive after their last owner */
+        void ReleaseExpired()
+        {
+            for (;;)
+            {
+                const auto entry = std::find_if(m_entries.begin(), m_entries.end(), [](const Entry& e) {
+                    return e.owner.expired();
+                });
+                if (entry == m_entries.end())
+                    return;
+
+                // Releasing the proxy may call out of the apartment, and a reentrant call may
+                // use the cache, so the entry is removed before the proxy is released
+                const CComPtr<IUnknown> proxy = std::move(entry->resolved);
+                m_entries.erase(entry);
+            }
+        }
+
+        bool RegisterSpy()
+        {
+            if (m_spy)
+                return true;
+
+            auto spy = Make<UninitializeSpy>(m_entries);
+            if (!spy || CoRegisterInitializeSpy(spy.Get(), &m_cookie) != S_OK)
+                return false;
+
+            m_spy = std::move(spy);
+            return true;
+        }
+
+        std::vector<Entry> m_entries;
+        ComPtr<UninitializeSpy> m_spy;
+        ULARGE_INTEGER m_cookie{};
+    };
+
+    ThreadCache& CacheOfThisThread()
+    {
+        static thread_local ThreadCache cache;
+        return cache;
+    }
+}
+
+uint64_t Detail::AgileResolveCache::NewId()
+{
+    // Shared by all interface types, since they share the cache of a thread
+    static std::atomic<uint64_t> next = 1;
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+IUnknown* Detail::AgileResolveCache::Find(uint64_t id)
+{
+    return CacheOfThisThread().Find(id);
+}
+
+void Detail::AgileResolveCache::Insert(uint64_t id, const std::shared_ptr<void>& owner, IUnknown* resolved)
+{
+    CacheOfThisThread().Insert(id, owner, resolved);
+}
@@ -1,8 +1,9 @@
 ﻿#include "pch.h"
-#include "ComApartment.h"
+#include "Include/ComUtility/ComApartment.h"
 #include "Include/ComUtility/Utility.h"
 #include <cassert>
 #include <ctxtcall.h>
+#include <new>
 #include <wrl.h>
 
 
@@ -67,6 +68,36 @@ namespace
         return event;
     }
 
+    /** Interactive tasks that may run in a row while background tasks are waiting */
+    constexpr size_t InteractiveBurst = 16;
+
+    void WritePostedTaskFailure(HRESULT result)
+    {
+        WriteToDebugger(L"ComApartment: Posted task", result);
+    }
+
+    /** Call a posted callable, and turn exceptions into HRESULTs, since nobody can catch them */
+    template <typename Callable>
+    HRESULT CallNoThrow(Callable& callable) noexcept
+    {
+        try
+        {
+            return callable();
+        }
+        catch (const ComException& e)
+        {
+            return e.result;
+        }
+        catch (const std::bad_alloc&)
+        {
+            return E_OUTOFMEMORY;
+        }
+        catch (...)
+        {
+            return E_FAIL;
+        }
+    }
+
     UINT RegisterTaskMessage(const std::wstring& messageName)
     {
         const auto message = RegisterWindowMessage(messageName.c_str());
@@ -76,10 +107,37 @@ namespace
     }
 }
 
+ThreadMessageWakeup::ThreadMessageWakeup(const std::atomic<DWORD>& threadId, const unsigned int& message)
+    : m_threadId{threadId}
+    , m_message{message}
+{
+}
+
+void ThreadMessageWakeup::Signal()
+{
+    assert(m_threadId != 0); // To document that at this time, m_threadId is always non-zero.
+
+    if (PostThreadMessage(m_threadId, m_message, 0, 0) == 0)
+        RaiseSystemError(GetLastError(), "Failed to execute task");
+}
+
 ComApartment::ComApartment()
+    : ComApartment(QueueLimits{})
+{
+}
+
+ComApartment::ComApartment(ErrorSink errorSink)
+    : ComApartment(QueueLimits{}, std::move(errorSink))
+{
+}
+
+ComApartment::ComApartment(QueueLimits limits, ErrorSink errorSink)
     : m_newTask{RegisterTaskMessage(L"ScThread_ComApartment_NewTask")}
+      , m_tasks{InteractiveBurst, std::move(limits), m_threadId, m_newTask}
+      , m_errorSink{errorSink ? std::move(errorSink) : ErrorSink{WritePostedTaskFailure}}
       , m_apartmentInitialized{CreateNonSignaledManualResetEvent()}
       , m_apartmentIsClosed{CreateNonSignaledManualResetEvent()}
+      , m_shutdownRequested{CreateNonSignaledManualResetEvent()}
 {
     m_thread = std::thread([this] {
         SetThreadDescription(GetCurrentThread(), L"ComApartment"); // Debugging help
@@ -92,7 +150,7 @@ ComApartment::ComApartment()
 
     // Initialize COM and the apartment context on the apartment
     // thread and throw if it fails.
-    HR(InvokeOnApartment([this] {
+    HR(InvokeOnApartment(InvokeOptions{}, [this] {
         const auto result = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
         m_context = std::make_unique<ApartmentContext>();
         return result;
@@ -100,77 +158,119 @@ ComApartment::ComApartment()
 }
 
 
-std::future<HRESULT> ComApartment::Invoke(std::function<HRESULT()> callable)
+HRESULT ComApartment::InvokeInContext(HRESULT (*function)(void*), void* data)
 {
-    // Make sure the callable is called within the scope of the apartment context
-    // to add a barrier between the bare COM apartment and the stubs that may get
-    // created
-    return InvokeOnApartment([func = std::move(callable), this]
-    {
-        return m_context->Invoke([&] { return func(); });
-    });
+    return m_context->Invoke([function, data] { return function(data); });
 }
 
-std::future<HRESULT> ComApartment::InvokeOnApartment(std::function<HRESULT()> callable)
+void ComApartment::Execute(void (*function)(void*), void (*cancel)(void*), void* data)
 {
-    assert(m_threadId != 0); // To document that at this time, m_threadId is always non-zero.
+    Enqueue(InvokeOptions{}, ExecuteTask(function, cancel, data), true);
+}
 
-    std::packaged_task<HRESULT()> task([func = std::move(callable), this]
+void ComApartment::Continue(void (*function)(void*), void (*cancel)(void*), void* data) noexcept
+{
+    // The work was accepted when the coroutine suspended, so it bypasses the queue limits.
+    // Blocking here could deadlock the thread that completed the awaited task.
+    try
     {
-        return func();
-    });
-
-    auto future = task.get_future();
-    m_queue.push_back(std::move(task));
-
-    if (PostThreadMessage(m_threadId, m_newTask, 0, 0) == 0)
+        Enqueue(InvokeOptions{}, ExecuteTask(function, cancel, data), false);
+    }
+    catch (...)
     {
-        // Message queue is likely full. Remove message from queue and throw.
-        // This gives strong exception guarantee. Do not pass result through
-        // the future, because we want to detect this failure immediately.
-        const auto err = GetLastError();
-        m_queue.pop_back();
-        RaiseSystemError(err, "Failed to execute task");
+        // Shut down, or the wakeup could not be posted
+        cancel(data);
     }
+}
+
+ComApartment::Task ComApartment::ExecuteTask(void (*function)(void*), void (*cancel)(void*), void* data)
+{
+    // Coroutines that are resumed here report their own errors through the future of the
+    // coroutine, so there is no need for a future of our own. A dropped coroutine must
+    // still be resumed, or it would leak, and its future would never complete.
+    auto task = [this, callable = InContext([function, data] {
+                     function(data);
+                     return S_OK;
+                 }), cancel, data](HRESULT dropped) mutable {
+        if (dropped != S_OK)
+        {
+            cancel(data);
+            return;
+        }
+
+        const auto result = CallNoThrow(callable);
+        if (result != S_OK)
+            m_errorSink(result);
+    };
+    static_assert(Task::StoresInline<decltype(task)>(), "Execute should not allocate for the task");
+    return task;
+}
+
+TaskFuture<HRESULT> ComApartment::InvokeOnApartment(const InvokeOptions& options, Callable callable)
+{
+    PackagedTask<HRESULT> packaged{std::move(callable)};
+    auto future = packaged.get_future();
 
+    auto task = [packaged = std::move(packaged)](HRESULT dropped) mutable {
+        if (dropped != S_OK)
+            packaged.skip(dropped);
+        else
+            packaged();
+    };
+    static_assert(Task::StoresInline<decltype(task)>(), "Invoke should not allocate for the task");
+
+    Enqueue(options, std::move(task), true);
     return future;
 }
 
-ComApartment::~ComApartment()
+void ComApartment::PostOnApartment(const InvokeOptions& options, Callable callable)
 {
-    const auto result = InvokeOnApartment([this] {
-        // We are shutting down the apartment, but to make sure CoUninitialize
-        // can complete, we need to disconnect any remaining proxies to ensure
-        // that we do not end up waiting on callbacks to client.
-        const auto result = m_context->Disconnect();
-        if (result != S_OK)
-            return result;
+    auto task = [this, callable = std::move(callable)](HRESULT dropped) mutable {
+        if (dropped != S_OK)
+            return; // Already counted as dropped
 
-        m_context = nullptr;
-        CoUninitialize();
-        return S_OK;
-    }).get();
+        const auto result = CallNoThrow(callable);
+        if (result != S_OK)
+            m_errorSink(result);
+    };
+    static_assert(Task::StoresInline<decltype(task)>(), "Post should not allocate for the task");
 
-    if (result != S_OK)
-        std::abort(); // Logically impossible
+    Enqueue(options, std::move(task), true);
+}
 
-    // If Windows message queue is full, we need to repeatedly
-    // try to post the quit message, hoping that the queue
-    // will eventually drain. Anyway, the thread will not join
-    // until the WM_QUIT message is received.
-    while (PostThreadMessage(m_threadId, WM_QUIT, 0, 0) == 0)
+void ComApartment::Enqueue(const InvokeOptions& options, Task task, bool bounded)
+{
+    // The message pump is only woken up if it is not already about to drain the queue.
+    // If posting the wakeup fails, the message queue is likely full. The task is then
+    // removed from the queue and the error is thrown. This gives strong exception
+    // guarantee. Do not pass result through the future, because we want to detect
+    // this failure immediately. The task is counted before the apartment thread can
+    // complete it, and the count is taken back if it was not queued after all.
+    m_metrics.RecordSubmitted();
+    try
     {
-        if (GetLastError() != ERROR_NOT_ENOUGH_QUOTA)
-        {
-            // If we get here, the thread id was invalid, or
-            // the message queue was not created. Both are
-            // logically impossible.
-            std::abort();
-        }
-
-        // Let the message pump get time to process some messages
-        Sleep(100);
+        QueuedTask queued{std::move(task), TaskMetrics::Clock::now(), options.deadline, options.cancellation};
+        if (bounded)
+            m_tasks.Submit(options.priority, std::move(queued));
+        else
+            m_tasks.SubmitUnbounded(options.priority, std::move(queued));
     }
+    catch (...)
+    {
+        m_metrics.RevertSubmitted();
+        throw;
+    }
+}
+
+ComApartment::~ComApartment()
+{
+    // Unlike a thread message, setting the event can not fail because the message
+    // queue is full, so there is no need to retry. The message pump rejects the
+    // pending tasks and shuts down the apartment as soon as it sees the event. Tasks that it
+    // drains before it sees the event are rejected as well.
+    m_shuttingDown.store(true, std::memory_order_relaxed);
+    if (SetEvent(m_shutdownRequested.Get()) == 0)
+        std::abort(); // Logically impossible
 
     // Pump messages while we are waiting for the apartment to shut down.
     // This is needed if an object on the apartment still needs to communicate
@@ -187,25 +287,87 @@ void ComApartment::RunMessagePump()
     PeekMessage(&firstMsg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
     m_threadId = GetCurrentThreadId();
 
+    // Coroutines that await on this thread are resumed on this apartment
+    const CurrentScope executor{this};
+
     // Let the caller know we are initialized and ready to go.
     SetEvent(m_apartmentInitialized.Get());
 
-    MSG msg{};
-    while (const auto result = GetMessage(&msg, nullptr, 0, 0))
+    const auto shutdownRequested = m_shutdownRequested.Get();
+    for (;;)
     {
-        if (-1 == result)
-            RaiseSystemError(GetLastError(), "Failed to get message from queue");
+        // The shutdown event has the lowest index, so it wins over pending messages.
+        // MWMO_INPUTAVAILABLE also wakes up for messages that were already in the queue.
+        const auto wait = MsgWaitForMultipleObjectsEx(1, &shutdownRequested, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+        if (wait == WAIT_OBJECT_0)
+            break;
+        if (wait == WAIT_FAILED)
+            RaiseSystemError(GetLastError(), "Failed to wait for messages");
 
-        if (msg.message == m_newTask)
+        MSG msg{};
+        while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
         {
-            auto callable = m_queue.pop_front();
-            callable();
-        }
+            if (msg.message == m_newTask)
+                RunTasks();
 
-        TranslateMessage(&msg);
-        DispatchMessage(&msg);
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
     }
 
+    Shutdown();
+
     if (SetEvent(m_apartmentIsClosed.Get()) == 0)
         RaiseSystemError(GetLastError(), "Failed to signal owning thread");
 }
+
+void ComApartment::RunTasks()
+{
+    // One wakeup is posted for a whole burst of tasks, so run everything that is queued,
+    // with interactive tasks ahead of background tasks
+    m_tasks.Drain([this](QueuedTask& queued) {
+        const auto started = TaskMetrics::Clock::now();
+
+        // Drop work that nobody waits for any more, so that an overloaded apartment can catch up.
+        // Once the destructor has been called, tasks that were queued behind it are rejected.
+        auto dropped = S_OK;
+        if (m_shuttingDown.load(std::memory_order_relaxed))
+            dropped = HRESULT_FROM_WIN32(ERROR_OPERATION_ABORTED);
+        else if (queued.cancellation.stop_requested())
+            dropped = HRESULT_FROM_WIN32(ERROR_CANCELLED);
+        else if (started > queued.deadline)
+            dropped = HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+
+        queued.task(dropped);
+        if (dropped != S_OK)
+        {
+            m_metrics.RecordDropped();
+            return;
+        }
+
+        m_metrics.RecordCompleted(queued.queuedAt, started, TaskMetrics::Clock::now());
+    }, [this](QueuedTask& queued) {
+        // Dropped by the overflow policy of a full queue
+        queued.task(HRESULT_FROM_WIN32(ERROR_NOT_ENOUGH_QUOTA));
+        m_metrics.RecordDropped();
+    });
+}
+
+void ComApartment::Shutdown()
+{
+    // Close the queue, and complete the tasks that have not started without running them,
+    // so that nobody is left waiting for a future
+    m_tasks.Shutdown([this](QueuedTask& queued) {
+        queued.task(HRESULT_FROM_WIN32(ERROR_OPERATION_ABORTED));
+        m_metrics.RecordDropped();
+    });
+
+    // We are shutting down the apartment, but to make sure CoUninitialize
+    // can complete, we need to disconnect any remaining proxies to ensure
+    // that we do not end up waiting on callbacks to client.
+    if (m_context->Disconnect() != S_OK)
+        std::abort(); // Logically impossible
+
+    m_context = nullptr;
+    CoUninitialize();
+}
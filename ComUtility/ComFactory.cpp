@@ -1,18 +1,259 @@
 #include "pch.h"
 
 #include "Include/ComUtility/ComFactory.h"
-#include "ComApartment.h"
+#include "Include/ComUtility/ComApartment.h"
+#include <algorithm>
+#include <new>
+#include <utility>
+#include <vector>
 #include <wrl.h>
 
 using Microsoft::WRL::ComPtr;
 
+namespace
+{
+    /** Class factories that are kept alive between calls, so that creating an object
+     * skips the class lookup and DllGetClassObject call done by CoCreateInstance.
+     * The server is locked with IClassFactory::LockServer while its factory is cached.
+     * Must only be used on the apartment that owns it. */
+    class ClassFactoryCache final
+    {
+    public:
+        ClassFactoryCache() = default;
+        ClassFactoryCache(const ClassFactoryCache&) = delete;
+        ClassFactoryCache& operator=(const ClassFactoryCache&) = delete;
+
+        ~ClassFactoryCache()
+        {
+            Clear();
+        }
+
+        HRESULT CreateInstance(const CLSID& rclsid, IUnknown* pUnkOuter, const IID& riid, void** ppv)
+        {
+            ComPtr<IClassFactory> factory;
+            const auto result = GetClassFactory(rclsid, factory);
+            if (result != S_OK)
+                return result;
+
+            return factory->CreateInstance(pUnkOuter, riid, ppv);
+        }
+
+        void Invalidate(const CLSID& rclsid)
+        {
+            const auto entry = Find(rclsid);
+            if (entry == m_entries.end())
+                return;
+
+            entry->factory->LockServer(FALSE);
+            m_entries.erase(entry);
+        }
+
+        void Clear()
+        {
+            for (const auto& entry : m_entries)
+                entry.factory->LockServer(FALSE);
+            m_entries.clear();
+        }
+
+    private:
+        struct Entry
+        {
+            CLSID clsid;
+            ComPtr<IClassFactory> factory;
+        };
+
+        /** Linear search, since a factory typically creates a handful of classes */
+        std::vector<Entry>::iterator Find(const CLSID& rclsid)
+        {
+            return std::find_if(m_entries.begin(), m_entries.end(), [&rclsid](const Entry& entry) {
+                return InlineIsEqualGUID(entry.clsid, rclsid);
+            });
+        }
+
+        HRESULT GetClassFactory(const CLSID& rclsid, ComPtr<IClassFactory>& factory)
+        {
+            const auto entry = Find(rclsid);
+            if (entry != m_entries.end())
+            {
+                factory = entry->factory;
+                return S_OK;
+            }
+
+            auto result = CoGetClassObject(rclsid, CLSCTX_INPROC_SERVER, nullptr, IID_PPV_ARGS(factory.GetAddressOf()));
+            if (result != S_OK)
+                return result;
+
+            result = factory->LockServer(TRUE);
+            if (result != S_OK)
+                return result;
+
+            try
+            {
+                m_entries.push_back(Entry{rclsid, factory});
+            }
+            catch (const std::bad_alloc&)
+            {
+                factory->LockServer(FALSE); // Not cached, but the factory can still be used
+            }
+            return S_OK;
+        }
+
+        std::vector<Entry> m_entries;
+    };
+
+    /** An apartment with its own class factory cache */
+    class FactoryApartment final
+    {
+    public:
+        /** Release the cached class factories on the apartment, before the apartment shuts down */
+        ~FactoryApartment()
+        {
+            m_apartment.Invoke([this] {
+                m_factories.Clear();
+                return S_OK;
+            }).get();
+        }
+
+        template <typename Callable>
+        TaskFuture<HRESULT> Invoke(Callable&& callable)
+        {
+            return m_apartment.Invoke(std::forward<Callable>(callable));
+        }
+
+        template <typename Callable>
+        TaskFuture<HRESULT> Invoke(TaskPriority priority, Callable&& callable)
+        {
+            return m_apartment.Invoke(priority, std::forward<Callable>(callable));
+        }
+
+        size_t QueueDepth() const
+        {
+            return m_apartment.QueueDepth();
+        }
+
+        TaskMetrics::Snapshot GetMetrics() const
+        {
+            return m_apartment.GetMetrics();
+        }
+
+        /** Must only be used on the apartment */
+        ClassFactoryCache& Factories()
+        {
+            return m_factories;
+        }
+
+    private:
+        ComApartment m_apartment;
+        ClassFactoryCache m_factories;
+    };
+
+    HRESULT CreateInstanceOnApartment(FactoryApartment& apartment, const IID& rclsid, IUnknown* pUnkOuter, const IID& riid, void** ppv)
+    {
+        // This stream will contain the marshaled interface to the created object
+        ComPtr<IStream> stream = nullptr;
+
+        // Delegate construction to the apartment, to create the object on a separate thread
+        const auto result = apartment.Invoke([&apartment, rclsid, pUnkOuter, &stream]()
+        {
+            ComPtr<IUnknown> punk;
+            const auto result = apartment.Factories().CreateInstance(
+                rclsid,
+                pUnkOuter,
+                IID_IUnknown,
+                reinterpret_cast<void**>(punk.GetAddressOf()));
+
+            if (result != S_OK)
+                return result;
+
+            // Marshal interface to the stream. This allows unmarshaling the interface
+            // in a different thread
+            return CoMarshalInterThreadInterfaceInStream(IID_IUnknown, punk.Get(), stream.GetAddressOf());
+        }).get();
+
+        if (result != S_OK)
+            return result;
+
+        // Get the interface marshaled onto the calling thread
+        return CoGetInterfaceAndReleaseStream(stream.Detach(), riid, ppv);
+    }
+
+    HRESULT Seek(IStream* stream, ULONGLONG position)
+    {
+        LARGE_INTEGER offset{};
+        offset.QuadPart = static_cast<LONGLONG>(position);
+        return stream->Seek(offset, STREAM_SEEK_SET, nullptr);
+    }
+
+    /** Release the marshal data at the given stream positions, so that the stubs they refer to are released */
+    void ReleaseMarshalData(IStream* stream, const ULONGLONG* positions, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (Seek(stream, positions[i]) == S_OK)
+                CoReleaseMarshalData(stream);
+        }
+    }
+
+    /** Create objects and marshal them one after the other into the stream. Returns the
+     * stream position of each marshaled object. Must be called on the apartment. */
+    HRESULT CreateAndMarshal(ClassFactoryCache& factories, const IID& rclsid, const IID& riid, size_t count, IStream* stream, std::vector<ULONGLONG>& positions)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            ULARGE_INTEGER position{};
+            auto result = stream->Seek(LARGE_INTEGER{}, STREAM_SEEK_CUR, &position);
+            ComPtr<IUnknown> punk;
+            if (result == S_OK)
+                result = factories.CreateInstance(rclsid, nullptr, riid, reinterpret_cast<void**>(punk.GetAddressOf()));
+            if (result == S_OK)
+                result = CoMarshalInterface(stream, riid, punk.Get(), MSHCTX_INPROC, nullptr, MSHLFLAGS_NORMAL);
+
+            if (result != S_OK)
+            {
+                ReleaseMarshalData(stream, positions.data(), positions.size());
+                positions.clear();
+                return result;
+            }
+
+            positions.push_back(position.QuadPart);
+        }
+        return S_OK;
+    }
+}
+
 struct ComFactory::impl
 {
-    ComApartment m_apartment;
+    explicit impl(const ApartmentPoolOptions& options)
+        : m_apartments{options, [] { return std::make_unique<FactoryApartment>(); }}
+    {
+    }
+
+    /** Run a function on all apartments, and return the first failure */
+    template <typename Function>
+    HRESULT InvokeOnAll(Function function)
+    {
+        auto result = S_OK;
+        m_apartments.ForEach([&result, &function](FactoryApartment& apartment) {
+            const auto invoked = apartment.Invoke([&apartment, &function] {
+                function(apartment);
+                return S_OK;
+            }).get();
+            if (result == S_OK)
+                result = invoked;
+        });
+        return result;
+    }
+
+    ApartmentPool<FactoryApartment> m_apartments;
 };
 
 ComFactory::ComFactory()
-    : m_impl{std::make_unique<impl>()}
+    : ComFactory(ApartmentPoolOptions{})
+{
+}
+
+ComFactory::ComFactory(const ApartmentPoolOptions& options)
+    : m_impl{std::make_unique<impl>(options)}
 {
 }
 
@@ -22,31 +263,117 @@ ComFactory::~ComFactory()
 
 HRESULT ComFactory::CreateInstance(const IID& rclsid, IUnknown* pUnkOuter, const IID& riid, void** ppv)
 {
-    // This stream will contain the marshaled interface to the created object
-    ComPtr<IStream> stream = nullptr;
+    return CreateInstanceOnApartment(m_impl->m_apartments.Select(), rclsid, pUnkOuter, riid, ppv);
+}
+
+HRESULT ComFactory::CreateInstance(size_t affinityKey, const IID& rclsid, IUnknown* pUnkOuter, const IID& riid, void** ppv)
+{
+    return CreateInstanceOnApartment(m_impl->m_apartments.Select(affinityKey), rclsid, pUnkOuter, riid, ppv);
+}
+
+HRESULT ComFactory::CreateInstances(const IID& rclsid, const IID& riid, size_t count, void** ppv)
+{
+    if (count == 0)
+        return S_OK;
+    if (!ppv)
+        return E_POINTER;
 
-    // Delegate construction to the apartment, to create the object on a separate thread
-    const auto result = m_impl->m_apartment.Invoke([rclsid, pUnkOuter, &stream]()
+    // Give all or nothing, also when returning early or throwing
+    std::fill(ppv, ppv + count, nullptr);
+
+    ComPtr<IStream> stream;
+    auto result = CreateStreamOnHGlobal(nullptr, TRUE, stream.GetAddressOf());
+    if (result != S_OK)
+        return result;
+
+    std::vector<ULONGLONG> positions;
+    positions.reserve(count);
+
+    // One hop creates and marshals the whole batch. The stream is only used by one thread at a time.
+    // A batch can keep the apartment busy for a while, so it yields to single object creation.
+    auto& apartment = m_impl->m_apartments.Select();
+    result = apartment.Invoke(TaskPriority::Background, [&apartment, &rclsid, &riid, count, &stream, &positions] {
+        return CreateAndMarshal(apartment.Factories(), rclsid, riid, count, stream.Get(), positions);
+    }).get();
+
+    if (result != S_OK)
+        return result;
+
+    // Unmarshal on the calling thread, in the order the objects were marshaled
+    result = Seek(stream.Get(), 0);
+    if (result != S_OK)
     {
-        ComPtr<IUnknown> punk;
-        const auto result = CoCreateInstance(
-            rclsid,
-            pUnkOuter,
-            CLSCTX_INPROC_SERVER,
-            IID_IUnknown,
-            reinterpret_cast<void**>(punk.GetAddressOf()));
+        ReleaseMarshalData(stream.Get(), positions.data(), positions.size());
+        return result;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        result = CoUnmarshalInterface(stream.Get(), riid, &ppv[i]);
+        if (result != S_OK)
+        {
+            // Give all or nothing. The marshal data of object i was consumed by CoUnmarshalInterface.
+            ppv[i] = nullptr;
+            for (size_t unmarshaled = 0; unmarshaled < i; ++unmarshaled)
+                static_cast<IUnknown*>(std::exchange(ppv[unmarshaled], nullptr))->Release();
+            ReleaseMarshalData(stream.Get(), positions.data() + i + 1, count - i - 1);
+            return result;
+        }
+    }
+
+    return S_OK;
+}
+
+HRESULT ComFactory::CreateSharedInstance(const CLSID& rclsid, const IID& riid, SharedInstance& instance)
+{
+    ComPtr<IGlobalInterfaceTable> table;
+    DWORD cookie = 0;
+
+    // The object must be registered from the apartment it lives in
+    auto& apartment = m_impl->m_apartments.Select();
+    const auto result = apartment.Invoke([&apartment, &rclsid, &riid, &table, &cookie] {
+        auto result = CoCreateInstance(CLSID_StdGlobalInterfaceTable, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(table.GetAddressOf()));
+        if (result != S_OK)
+            return result;
 
+        ComPtr<IUnknown> punk;
+        result = apartment.Factories().CreateInstance(rclsid, nullptr, riid, reinterpret_cast<void**>(punk.GetAddressOf()));
         if (result != S_OK)
             return result;
 
-        // Marshal interface to the stream. This allows unmarshaling the interface
-        // in a different thread
-        return CoMarshalInterThreadInterfaceInStream(IID_IUnknown, punk.Get(), stream.GetAddressOf());
+        return table->RegisterInterfaceInGlobal(punk.Get(), riid, &cookie);
     }).get();
 
     if (result != S_OK)
         return result;
 
-    // Get the interface marshaled onto the calling thread
-    return CoGetInterfaceAndReleaseStream(stream.Detach(), riid, ppv);
+    return SharedInstance::Adopt(table.Get(), cookie, riid, instance);
+}
+
+HRESULT ComFactory::InvalidateClassFactory(const CLSID& rclsid)
+{
+    return m_impl->InvokeOnAll([&rclsid](FactoryApartment& apartment) {
+        apartment.Factories().Invalidate(rclsid);
+    });
+}
+
+HRESULT ComFactory::InvalidateClassFactories()
+{
+    return m_impl->InvokeOnAll([](FactoryApartment& apartment) {
+        apartment.Factories().Clear();
+    });
+}
+
+TaskMetrics::Snapshot ComFactory::GetMetrics() const
+{
+    TaskMetrics::Snapshot metrics;
+    m_impl->m_apartments.ForEach([&metrics](const FactoryApartment& apartment) {
+        metrics += apartment.GetMetrics();
+    });
+    return metrics;
+}
+
+size_t ComFactory::ApartmentCount() const
+{
+    return m_impl->m_apartments.Size();
 }
@@ -0,0 +1,208 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+/** How an ApartmentPool selects the apartment for new work */
+enum class Placement
+{
+    RoundRobin,      ///< Cycle through the active apartments
+    LeastQueueDepth, ///< Pick the active apartment with the fewest queued tasks
+    AffinityKey,     ///< Pick the apartment from a key supplied by the caller, so related objects share apartment
+};
+
+struct ApartmentPoolOptions
+{
+    size_t minApartments = 1;                  ///< Number of apartments created up front
+    size_t maxApartments = 1;                  ///< The pool never grows beyond this number of apartments
+    Placement placement = Placement::RoundRobin;
+
+    /** Activate another apartment when the least loaded apartment has more queued tasks than
+     * this. Zero disables growing. */
+    size_t growQueueDepth = 0;
+
+    /** Deactivate an apartment after this many consecutive placements where all active
+     * apartments were idle. Zero disables shrinking. */
+    size_t shrinkAfterIdlePlacements = 0;
+};
+
+/** A pool of apartments with load balancing.
+ *
+ * The Apartment type must provide a QueueDepth() function that returns the number of
+ * tasks waiting to be run.
+ *
+ * Apartments can not be destroyed while objects live on them, because destroying an
+ * apartment disconnects its objects. Shrinking therefore only deactivates apartments,
+ * so that they are no longer selected for new work. A deactivated apartment is
+ * reactivated before new apartments are created, and all apartments are destroyed
+ * with the pool. */
+template <typename Apartment>
+class ApartmentPool final
+{
+public:
+    using Factory = std::function<std::unique_ptr<Apartment>()>;
+
+    ApartmentPool(const ApartmentPoolOptions& options, Factory factory)
+        : m_options(options)
+        , m_factory(std::move(factory))
+        , m_apartments(std::make_unique<std::unique_ptr<Apartment>[]>(options.maxApartments))
+    {
+        if (options.minApartments == 0 || options.minApartments > options.maxApartments)
+            throw std::invalid_argument("ApartmentPool requires 0 < minApartments <= maxApartments");
+
+        for (size_t i = 0; i < options.minApartments; ++i)
+            m_apartments[i] = m_factory();
+
+        m_created = options.minApartments;
+        m_active = options.minApartments;
+    }
+
+    ApartmentPool(const ApartmentPool&) = delete;
+    ApartmentPool& operator=(const ApartmentPool&) = delete;
+
+    /** Select an apartment according to the placement policy. With AffinityKey placement,
+     * work without a key goes to the first apartment. */
+    Apartment& Select()
+    {
+        switch (m_options.placement)
+        {
+        case Placement::LeastQueueDepth:
+            return SelectLeastLoaded();
+        case Placement::AffinityKey:
+            return Select(0);
+        case Placement::RoundRobin:
+        default:
+            return SelectRoundRobin();
+        }
+    }
+
+    /** Select the apartment for an affinity key. The same key maps to the same apartment
+     * as long as the number of apartments does not change. Affinity placement selects
+     * among all created apartments, and does not grow or shrink the pool. */
+    Apartment& Select(size_t affinityKey)
+    {
+        const auto created = m_created.load(std::memory_order_acquire);
+        return *m_apartments[std::hash<size_t>{}(affinityKey) % created];
+    }
+
+    /** Number of apartments that have been created */
+    size_t Size() const
+    {
+        return m_created.load(std::memory_order_acquire);
+    }
+
+    /** Number of apartments that are selected for new work */
+    size_t ActiveCount() const
+    {
+        return m_active.load(std::memory_order_acquire);
+    }
+
+    /** Visit all created apartments */
+    template <typename Visitor>
+    void ForEach(Visitor&& visitor) const
+    {
+        const auto created = m_created.load(std::memory_order_acquire);
+        for (size_t i = 0; i < created; ++i)
+            visitor(*m_apartments[i]);
+    }
+
+private:
+    Apartment& SelectRoundRobin()
+    {
+        const auto active = m_active.load(std::memory_order_acquire);
+        auto& apartment = *m_apartments[m_next.fetch_add(1, std::memory_order_relaxed) % active];
+        return Rebalance(apartment, active);
+    }
+
+    Apartment& SelectLeastLoaded()
+    {
+        const auto active = m_active.load(std::memory_order_acquire);
+        auto selected = m_apartments[0].get();
+        auto selectedDepth = selected->QueueDepth();
+        for (size_t i = 1; i < active && selectedDepth != 0; ++i)
+        {
+            const auto depth = m_apartments[i]->QueueDepth();
+            if (depth < selectedDepth)
+            {
+                selected = m_apartments[i].get();
+                selectedDepth = depth;
+            }
+        }
+        return Rebalance(*selected, active);
+    }
+
+    /** Grow or shrink the active set based on the queue depth of the selected apartment,
+     * and return the apartment the work should go to */
+    Apartment& Rebalance(Apartment& selected, size_t active)
+    {
+        const auto depth = selected.QueueDepth();
+
+        if (m_options.growQueueDepth != 0 && depth > m_options.growQueueDepth && active < m_options.maxApartments)
+        {
+            m_idlePlacements.store(0, std::memory_order_relaxed);
+            if (auto grown = Grow(active))
+                return *grown;
+        }
+        else if (m_options.shrinkAfterIdlePlacements != 0 && active > m_options.minApartments && IsIdle(active))
+        {
+            if (m_idlePlacements.fetch_add(1, std::memory_order_relaxed) + 1 >= m_options.shrinkAfterIdlePlacements)
+                Shrink(active);
+        }
+        else
+        {
+            m_idlePlacements.store(0, std::memory_order_relaxed);
+        }
+
+        return selected;
+    }
+
+    bool IsIdle(size_t active) const
+    {
+        for (size_t i = 0; i < active; ++i)
+        {
+            if (m_apartments[i]->QueueDepth() != 0)
+                return false;
+        }
+        return true;
+    }
+
+    /** Activate one more apartment, unless another thread already did. Returns the new apartment. */
+    Apartment* Grow(size_t observedActive)
+    {
+        std::lock_guard guard(m_mutex);
+        const auto active = m_active.load(std::memory_order_relaxed);
+        if (active != observedActive || active == m_options.maxApartments)
+            return nullptr;
+
+        if (active == m_created.load(std::memory_order_relaxed))
+        {
+            m_apartments[active] = m_factory();
+            m_created.store(active + 1, std::memory_order_release);
+        }
+
+        m_active.store(active + 1, std::memory_order_release);
+        return m_apartments[active].get();
+    }
+
+    void Shrink(size_t observedActive)
+    {
+        std::lock_guard guard(m_mutex);
+        if (m_active.load(std::memory_order_relaxed) != observedActive)
+            return;
+
+        m_active.store(observedActive - 1, std::memory_order_release);
+        m_idlePlacements.store(0, std::memory_order_relaxed);
+    }
+
+    const ApartmentPoolOptions m_options;
+    const Factory m_factory;
+    std::unique_ptr<std::unique_ptr<Apartment>[]> m_apartments; ///< Fixed capacity, so readers never see a reallocation
+    std::atomic<size_t> m_created = 0;          ///< Number of apartments that are created
+    std::atomic<size_t> m_active = 0;           ///< The first m_active apartments are selected for new work
+    std::atomic<size_t> m_next = 0;             ///< Round robin counter
+    std::atomic<size_t> m_idlePlacements = 0;   ///< Consecutive placements where all active apartments were idle
+    std::mutex m_mutex;                         ///< Serializes growing and shrinking
+};
@@ -0,0 +1,71 @@
+#pragma once
+#include "Utility.h"
+#include <cstdint>
+#include <memory>
+#include <new>
+
+namespace Detail
+{
+    /** Interfaces resolved from agile references on the calling thread.
+     *
+     * The cache of a thread is emptied when the thread leaves COM with its last
+     * CoUninitialize, which is detected with an IInitializeSpy. The proxies are then
+     * released while the apartment still exists, and interfaces are resolved again if the
+     * thread joins an apartment later. */
+    class AgileResolveCache final
+    {
+    public:
+        /** Key for a new owner. Unlike an address, it is never reused. */
+        static uint64_t NewId();
+
+        /** Borrowed pointer to the interface resolved for the given owner, or nullptr.
+         * Releases the entries of destroyed owners on this thread first. */
+        static IUnknown* Find(uint64_t id);
+
+        /** Cache an interface for the calling thread. The owner is tracked weakly, so that
+         * entries of destroyed owners are released on the next lookup on this thread. */
+        static void Insert(uint64_t id, const std::shared_ptr<void>& owner, IUnknown* resolved);
+    };
+}
+
+/** Agile reference that remembers the interface it resolved on each thread.
+ *
+ * AgilePtr::Get calls IAgileReference::Resolve on every call, which unmarshals a new
+ * proxy each time. CachedAgilePtr resolves once per thread and COM session, and later
+ * calls on the same thread return the cached proxy after a single AddRef.
+ *
+ * A proxy can only be released in the apartment that resolved it, so the destructor can
+ * not release the proxies cached by other threads. A thread releases the proxies of
+ * destroyed CachedAgilePtrs the next time it looks up any cached interface, and all its
+ * proxies when it calls its last CoUninitialize. */
+template <typename T>
+class CachedAgilePtr final
+{
+public:
+    explicit CachedAgilePtr(T* ifPointer)
+        : m_id(Detail::AgileResolveCache::NewId())
+        , m_agile(std::make_shared<AgilePtr<T>>(ifPointer))
+    {
+    }
+
+    CComPtr<T> Get() const
+    {
+        if (const auto cached = Detail::AgileResolveCache::Find(m_id))
+            return CComPtr<T>{static_cast<T*>(cached)};
+
+        auto resolved = m_agile->Get();
+        try
+        {
+            Detail::AgileResolveCache::Insert(m_id, m_agile, static_cast<IUnknown*>(resolved.p));
+        }
+        catch (const std::bad_alloc&)
+        {
+            // Not cached, but the proxy can still be used
+        }
+        return resolved;
+    }
+
+private:
+    uint64_t m_id; ///< Identifies the reference in the thread caches
+    std::shared_ptr<AgilePtr<T>> m_agile; ///< Shared with copies. Thread caches track it weakly.
+};
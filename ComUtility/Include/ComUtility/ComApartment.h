@@ -0,0 +1,227 @@
+#pragma once
+#include "Coroutine.h"
+#include "Executor.h"
+#include "PriorityTaskDispatcher.h"
+#include "TaskFuture.h"
+#include "TaskMetrics.h"
+#include <functional>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <wrl/wrappers/corewrappers.h>
+
+using Event = Microsoft::WRL::Wrappers::Event;
+class ApartmentContext;
+
+/** Wakes up the apartment message pump by posting a thread message */
+class ThreadMessageWakeup final
+{
+public:
+    ThreadMessageWakeup(const std::atomic<DWORD>& threadId, const unsigned int& message);
+
+    /** Post the message, and throw if the message queue is full */
+    void Signal();
+
+private:
+    const std::atomic<DWORD>& m_threadId;
+    const unsigned int& m_message;
+};
+
+/** How a task is queued on a ComApartment, and when it is dropped instead of run */
+struct InvokeOptions
+{
+    TaskPriority priority = TaskPriority::Interactive;
+
+    /** The task is dropped if it has not started by this time, and its future holds
+     * HRESULT_FROM_WIN32(ERROR_TIMEOUT) */
+    TaskMetrics::Clock::time_point deadline = TaskMetrics::Clock::time_point::max();
+
+    /** The task is dropped if a stop is requested before it starts, and its future holds
+     * HRESULT_FROM_WIN32(ERROR_CANCELLED). A task that has started always runs to completion. */
+    std::stop_token cancellation;
+};
+
+/** Utility class that allows executing functions in its own thread/apartment.
+ * This models the active object design pattern. */
+class ComApartment final : public Executor
+{
+public:
+    /** Receives the failures of posted tasks on the apartment thread */
+    using ErrorSink = std::function<void(HRESULT)>;
+
+    /** Create an apartment that writes failures of posted tasks to the debugger output */
+    ComApartment();
+
+    /** Create an apartment that reports failures of posted tasks to the error sink. The sink
+     * is called on the apartment thread, and must not throw. */
+    explicit ComApartment(ErrorSink errorSink);
+
+    /** Create an apartment with a bounded task queue. When the queue is full, Invoke and Post
+     * block, throw std::system_error, or accept the task and drop the oldest queued tasks,
+     * depending on the overflow policy. Dropped tasks complete with
+     * HRESULT_FROM_WIN32(ERROR_NOT_ENOUGH_QUOTA). Without an error sink, failures of posted
+     * tasks are written to the debugger output. */
+    explicit ComApartment(QueueLimits limits, ErrorSink errorSink = {});
+
+    /** Destructor disconnects all proxies from their stubs. After the apartment is
+     * destroyed, calling any functions on the objects created on the apartment will fail.
+     * Tasks that have not started are not run. Their futures complete with
+     * HRESULT_FROM_WIN32(ERROR_OPERATION_ABORTED), and they are counted as dropped. */
+    ~ComApartment() override;
+
+    /** Executes function objects on the apartment. Typically, such function objects will
+     * create COM objects. Callables with small captures are queued without heap allocations. */
+    template <typename Callable>
+    TaskFuture<HRESULT> Invoke(Callable&& callable)
+    {
+        return Invoke(TaskPriority::Interactive, std::forward<Callable>(callable));
+    }
+
+    /** Executes function objects on the apartment in the given lane. Interactive tasks run
+     * ahead of queued background tasks, so use the background lane for bulk work that
+     * nobody is waiting for right away. */
+    template <typename Callable>
+    TaskFuture<HRESULT> Invoke(TaskPriority priority, Callable&& callable)
+    {
+        return Invoke(InvokeOptions{priority}, std::forward<Callable>(callable));
+    }
+
+    /** Executes function objects on the apartment, unless they are cancelled or expire
+     * while they are queued. Dropping work that nobody waits for any more lets an
+     * overloaded apartment catch up, instead of building an ever growing queue:
+     * @code
+     * apartment.Invoke({.deadline = TaskMetrics::Clock::now() + 100ms}, callable);
+     * @endcode */
+    template <typename Callable>
+    TaskFuture<HRESULT> Invoke(const InvokeOptions& options, Callable&& callable)
+    {
+        return InvokeOnApartment(options, InContext(std::forward<Callable>(callable)));
+    }
+
+    /** Executes function objects on the apartment without returning a future, for one-way
+     * calls like notifications and releases. This avoids the shared state of the future,
+     * so a posted callable with a small capture costs only its queue node. Failed HRESULTs
+     * and exceptions are reported to the error sink. Posted tasks that are cancelled or
+     * expire are counted as dropped, but are not reported. */
+    template <typename Callable>
+    void Post(Callable&& callable)
+    {
+        PostOnApartment(InvokeOptions{}, InContext(std::forward<Callable>(callable)));
+    }
+
+    template <typename Callable>
+    void Post(const InvokeOptions& options, Callable&& callable)
+    {
+        PostOnApartment(options, InContext(std::forward<Callable>(callable)));
+    }
+
+    /** Awaitable version of Invoke. The awaiting coroutine is suspended while the callable
+     * runs on the apartment, and is resumed on the executor of the awaiting thread, so no
+     * thread is blocked waiting for the result. */
+    template <typename Callable>
+    TaskAwaiter<HRESULT> InvokeAsync(Callable&& callable)
+    {
+        return TaskAwaiter<HRESULT>{Invoke(std::forward<Callable>(callable))};
+    }
+
+    template <typename Callable>
+    TaskAwaiter<HRESULT> InvokeAsync(const InvokeOptions& options, Callable&& callable)
+    {
+        return TaskAwaiter<HRESULT>{Invoke(options, std::forward<Callable>(callable))};
+    }
+
+    /** Awaitable that resumes the awaiting coroutine on the apartment thread, inside the
+     * apartment context. Use it to make several calls on the apartment in a row:
+     * @code
+     * co_await apartment.Schedule();
+     * // Runs on the apartment
+     * @endcode */
+    ResumeOn Schedule()
+    {
+        return ResumeOn{*this};
+    }
+
+    /** Run function(data) on the apartment, inside the apartment context. If the task is
+     * dropped, or the apartment is shut down, cancel(data) is called instead. */
+    void Execute(void (*function)(void*), void (*cancel)(void*), void* data) override;
+
+    /** Same as Execute, but the task is queued even if the queue is full, and cancelled
+     * instead of throwing if it can not be queued */
+    void Continue(void (*function)(void*), void (*cancel)(void*), void* data) noexcept override;
+
+    /** Number of tasks in both lanes that are queued, but not yet started. Used for load balancing. */
+    size_t QueueDepth() const
+    {
+        return m_tasks.PendingCount();
+    }
+
+    /** Counters and latency histograms for the tasks that have gone through the apartment,
+     * including the number of tasks that were dropped.
+     * Cheap to call, and safe to poll from any thread. */
+    TaskMetrics::Snapshot GetMetrics() const
+    {
+        return m_metrics.GetSnapshot(QueueDepth());
+    }
+
+private:
+    using Callable = SmallFunction<HRESULT()>;
+
+    /** Runs the task when called with S_OK. When called with an error, the task was dropped,
+     * and completes with that error without running. Fits an invoked or a posted Callable. */
+    using Task = SmallFunction<void(HRESULT), 96>;
+
+    /** A task with the time it was queued, for metrics, and the conditions for dropping it */
+    struct QueuedTask
+    {
+        Task task;
+        TaskMetrics::Clock::time_point queuedAt;
+        TaskMetrics::Clock::time_point deadline;
+        std::stop_token cancellation;
+    };
+
+    /** Wrap a callable, so that it is called within the scope of the apartment context.
+     * This adds a barrier between the bare COM apartment and the stubs that may get created. */
+    template <typename Function>
+    auto InContext(Function&& function)
+    {
+        return [this, func = std::forward<Function>(function)]() mutable
+        {
+            return InvokeInContext([](void* data) {
+                return (*static_cast<std::decay_t<Function>*>(data))();
+            }, &func);
+        };
+    }
+
+    TaskFuture<HRESULT> InvokeOnApartment(const InvokeOptions& options, Callable callable);
+    void PostOnApartment(const InvokeOptions& options, Callable callable);
+
+    /** Task for Execute and Continue, that calls cancel(data) instead of function(data) when dropped */
+    Task ExecuteTask(void (*function)(void*), void (*cancel)(void*), void* data);
+
+    /** Queue a task for the apartment thread. Bounded tasks are subject to the queue limits */
+    void Enqueue(const InvokeOptions& options, Task task, bool bounded);
+
+    /** Call a function inside the apartment context. Must be called on the apartment thread. */
+    HRESULT InvokeInContext(HRESULT (*function)(void*), void* data);
+
+    void RunMessagePump();
+
+    /** Run the queued tasks. Called on the apartment thread when the pump is woken up. */
+    void RunTasks();
+
+    /** Reject pending tasks, and leave the apartment. Called on the apartment thread. */
+    void Shutdown();
+
+    std::atomic<DWORD> m_threadId = 0;                          ///< Thread id of the apartment thread
+    std::atomic<bool> m_shuttingDown = false;                   ///< Set by the destructor, so that queued tasks are rejected instead of run
+    const unsigned int m_newTask;                               ///< Sentinel value used to communicate new tasks to message pump
+    PriorityTaskDispatcher<QueuedTask, ThreadMessageWakeup> m_tasks; ///< Queues of tasks to be executed on apartment thread
+    TaskMetrics m_metrics;                                      ///< Updated for every task
+    ErrorSink m_errorSink;                                      ///< Receives failures of posted tasks
+    std::thread m_thread;                                       ///< The thread that hosts the apartment
+    std::unique_ptr<ApartmentContext> m_context;                ///< An 'apartment' inside the apartment created by CoInitialize to disconnect proxy/stubs during destruction
+    Event m_apartmentInitialized;                               ///< Signals that message pump has started and is ready to receive requests
+    Event m_apartmentIsClosed;                                  ///< Signals to the calling thread that the apartment thread is done, and it is safe to join the thread.
+    Event m_shutdownRequested;                                  ///< Signals to the message pump that the apartment is being destroyed
+};
+
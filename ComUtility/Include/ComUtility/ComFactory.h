@@ -1,13 +1,24 @@
 #pragma once
+#include "ApartmentPool.h"
+#include "SharedInstance.h"
+#include "TaskMetrics.h"
 #include <memory>
 #include <Unknwn.h>
 
-/** Utility class that allows creating instances on its own single threaded apartment */
+/** Utility class that allows creating instances on its own single threaded apartments.
+ *
+ * Each apartment caches the class factory of the classes it creates, and keeps their
+ * servers locked until the factory is invalidated or destroyed. */
 class ComFactory final
 {
 public:
+    /** Create a factory with a single apartment */
     ComFactory();
 
+    /** Create a factory with a pool of apartments. Instances are spread over the
+     * apartments according to the placement policy in the options. */
+    explicit ComFactory(const ApartmentPoolOptions& options);
+
     /** Destructor disconnects all proxies from their stubs. After the apartment is
      * destroyed, calling any functions on the objects created on the apartment will fail */
     ~ComFactory();
@@ -16,6 +27,36 @@ public:
      * communicates with a corresponding stub on the apartment. */
     HRESULT CreateInstance(const IID& rclsid, IUnknown* pUnkOuter, const IID& riid, void** ppv);
 
+    /** Create an instance of a COM object on the apartment selected by the affinity key.
+     * Instances created with the same key share apartment, as long as the pool does not grow. */
+    HRESULT CreateInstance(size_t affinityKey, const IID& rclsid, IUnknown* pUnkOuter, const IID& riid, void** ppv);
+
+    /** Create count instances of a COM object on one apartment, with a single apartment hop
+     * for the whole batch. The objects are marshaled into one stream on the apartment and
+     * unmarshaled on the calling thread. Either all count interface pointers are returned
+     * in ppv, or none are. The batch runs in the background lane of the apartment, so that
+     * CreateInstance calls from other threads are not held up behind it. */
+    HRESULT CreateInstances(const IID& rclsid, const IID& riid, size_t count, void** ppv);
+
+    /** Create an instance of a COM object on the apartment, and register it in the Global
+     * Interface Table. Unlike the proxy returned by CreateInstance, which can only be used on
+     * the calling thread, the handle can be shared by any number of threads. Each of them
+     * gets its own proxy to the same object. */
+    HRESULT CreateSharedInstance(const CLSID& rclsid, const IID& riid, SharedInstance& instance);
+
+    /** Release the cached class factory for a class on all apartments, and unlock its server.
+     * The next instance of the class is created through a fresh class object. */
+    HRESULT InvalidateClassFactory(const CLSID& rclsid);
+
+    /** Release all cached class factories */
+    HRESULT InvalidateClassFactories();
+
+    /** Task counters and latency histograms, summed over all apartments of the factory */
+    TaskMetrics::Snapshot GetMetrics() const;
+
+    /** Number of apartments that have been created by the factory */
+    size_t ApartmentCount() const;
+
 private:
     struct impl;
     std::unique_ptr<impl> m_impl;
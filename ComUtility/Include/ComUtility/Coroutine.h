@@ -0,0 +1,181 @@
+#pragma once
+#include "Executor.h"
+#include "TaskFuture.h"
+#include <coroutine>
+#include <exception>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+/** Awaitable that suspends the coroutine until a TaskFuture is ready, without blocking a thread.
+ *
+ * The coroutine is resumed on the executor of the thread that awaited the future, so a
+ * coroutine that runs on an apartment continues on that apartment. If the awaiting thread
+ * is not owned by an executor, the coroutine resumes on the thread that completed the task.
+ * If the executor can not resume the coroutine, because it is shut down or drops the work,
+ * the co_await throws std::system_error with std::errc::operation_canceled instead. */
+template <typename T>
+class [[nodiscard]] TaskAwaiter final
+{
+public:
+    explicit TaskAwaiter(TaskFuture<T> future) noexcept : m_future(std::move(future)) {}
+
+    bool await_ready() const
+    {
+        return m_future.is_ready();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        m_handle = handle;
+        m_executor = Executor::Current();
+        return m_future.set_continuation(&Continue, this);
+    }
+
+    T await_resume()
+    {
+        if (m_cancelled)
+            throw std::system_error(std::make_error_code(std::errc::operation_canceled), "The executor could not resume the coroutine");
+        return m_future.get();
+    }
+
+private:
+    /** Called on the thread that completed the task */
+    static void Continue(void* context) noexcept
+    {
+        const auto self = static_cast<TaskAwaiter*>(context);
+        if (self->m_executor)
+            self->m_executor->Continue(&Resume, &Cancel, self);
+        else
+            self->m_handle.resume();
+    }
+
+    static void Resume(void* context)
+    {
+        static_cast<TaskAwaiter*>(context)->m_handle.resume();
+    }
+
+    /** Resume anyway, so that the coroutine is not leaked, and let the co_await throw */
+    static void Cancel(void* context)
+    {
+        const auto self = static_cast<TaskAwaiter*>(context);
+        self->m_cancelled = true;
+        self->m_handle.resume();
+    }
+
+    TaskFuture<T> m_future;
+    std::coroutine_handle<> m_handle;
+    Executor* m_executor = nullptr;
+    bool m_cancelled = false;
+};
+
+template <typename T>
+TaskAwaiter<T> operator co_await(TaskFuture<T>&& future) noexcept
+{
+    return TaskAwaiter<T>{std::move(future)};
+}
+
+/** Awaitable that moves the coroutine over to an executor. Throws at the co_await if the
+ * executor can not accept more work. If the executor accepts the work, but drops it or shuts
+ * down before it runs, the co_await throws std::system_error with std::errc::operation_canceled
+ * on the thread that dropped it. */
+class [[nodiscard]] ResumeOn final
+{
+public:
+    explicit ResumeOn(Executor& executor) noexcept : m_executor(executor) {}
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_handle = handle;
+        m_executor.Execute(&Resume, &Cancel, this);
+    }
+
+    void await_resume() const
+    {
+        if (m_cancelled)
+            throw std::system_error(std::make_error_code(std::errc::operation_canceled), "The executor dropped the coroutine");
+    }
+
+private:
+    static void Resume(void* context)
+    {
+        static_cast<ResumeOn*>(context)->m_handle.resume();
+    }
+
+    static void Cancel(void* context)
+    {
+        const auto self = static_cast<ResumeOn*>(context);
+        self->m_cancelled = true;
+        self->m_handle.resume();
+    }
+
+    Executor& m_executor;
+    std::coroutine_handle<> m_handle;
+    bool m_cancelled = false;
+};
+
+namespace Detail
+{
+    /** Coroutine promise that completes a TaskFuture. The coroutine starts eagerly on the calling thread. */
+    template <typename T>
+    class TaskPromiseBase
+    {
+    public:
+        TaskFuture<T> get_return_object()
+        {
+            return m_promise.get_future();
+        }
+
+        std::suspend_never initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void unhandled_exception()
+        {
+            m_promise.set_exception(std::current_exception());
+        }
+
+    protected:
+        TaskPromise<T> m_promise;
+    };
+
+    template <typename T>
+    class CoroutinePromise final : public TaskPromiseBase<T>
+    {
+    public:
+        template <typename Value>
+        void return_value(Value&& value)
+        {
+            this->m_promise.set_value(std::forward<Value>(value));
+        }
+    };
+
+    template <>
+    class CoroutinePromise<void> final : public TaskPromiseBase<void>
+    {
+    public:
+        void return_void()
+        {
+            m_promise.set_value();
+        }
+    };
+}
+
+/** Lets coroutines return TaskFuture<T>, so that they can be awaited by other coroutines,
+ * or waited for with get() by code that is not a coroutine */
+template <typename T, typename... Args>
+struct std::coroutine_traits<TaskFuture<T>, Args...>
+{
+    using promise_type = Detail::CoroutinePromise<T>;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+/** Something that runs work on its own threads, like an apartment or a thread pool.
+ *
+ * Threads that are owned by an executor register it as their current executor. This
+ * lets awaitables resume a coroutine on the executor it was running on before it was
+ * suspended. */
+class Executor
+{
+public:
+    virtual ~Executor() = default;
+
+    /** Run function(data) on one of the executor's threads. Throws if the work could not be queued.
+     * If the work is queued, but dropped or shut down before it runs, cancel(data) is called
+     * instead, so that work like a suspended coroutine is never lost. */
+    virtual void Execute(void (*function)(void*), void (*cancel)(void*), void* data) = 0;
+
+    /** Run function(data) like Execute, for work that has been accepted already, like resuming
+     * a coroutine when the task it awaits has completed. Such work can not be refused, so this
+     * does not throw, and must not block because the executor is busy. If function(data) can
+     * not be run, cancel(data) is called instead, either on the calling thread or on the executor. */
+    virtual void Continue(void (*function)(void*), void (*cancel)(void*), void* data) noexcept
+    {
+        try
+        {
+            Execute(function, cancel, data);
+        }
+        catch (...)
+        {
+            cancel(data);
+        }
+    }
+
+    /** The executor that owns the current thread, or nullptr if the thread is not owned by an executor */
+    static Executor* Current() noexcept
+    {
+        return CurrentSlot();
+    }
+
+protected:
+    /** Registers an executor as the current executor while in scope */
+    class CurrentScope final
+    {
+    public:
+        explicit CurrentScope(Executor* executor) noexcept : m_previous(CurrentSlot())
+        {
+            CurrentSlot() = executor;
+        }
+
+        ~CurrentScope()
+        {
+            CurrentSlot() = m_previous;
+        }
+
+        CurrentScope(const CurrentScope&) = delete;
+        CurrentScope& operator=(const CurrentScope&) = delete;
+
+    private:
+        Executor* m_previous;
+    };
+
+private:
+    static Executor*& CurrentSlot() noexcept
+    {
+        static thread_local Executor* current = nullptr;
+        return current;
+    }
+};
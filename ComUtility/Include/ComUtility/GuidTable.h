@@ -0,0 +1,237 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+
+/** GUID that can be parsed, compared and hashed at compile time, and on any platform.
+ * The fields match the layout of the GUID structure of Windows. */
+struct GuidValue
+{
+    uint32_t data1 = 0;
+    uint16_t data2 = 0;
+    uint16_t data3 = 0;
+    std::array<uint8_t, 8> data4{};
+};
+
+constexpr bool operator==(const GuidValue& left, const GuidValue& right) noexcept
+{
+    if (left.data1 != right.data1 || left.data2 != right.data2 || left.data3 != right.data3)
+        return false;
+
+    for (size_t i = 0; i < left.data4.size(); ++i)
+    {
+        if (left.data4[i] != right.data4[i])
+            return false;
+    }
+    return true;
+}
+
+constexpr bool operator!=(const GuidValue& left, const GuidValue& right) noexcept
+{
+    return !(left == right);
+}
+
+/** Orders by data1 first. data1 is random in generated GUIDs, so most comparisons end there */
+constexpr bool operator<(const GuidValue& left, const GuidValue& right) noexcept
+{
+    if (left.data1 != right.data1)
+        return left.data1 < right.data1;
+    if (left.data2 != right.data2)
+        return left.data2 < right.data2;
+    if (left.data3 != right.data3)
+        return left.data3 < right.data3;
+
+    for (size_t i = 0; i < left.data4.size(); ++i)
+    {
+        if (left.data4[i] != right.data4[i])
+            return left.data4[i] < right.data4[i];
+    }
+    return false;
+}
+
+namespace GuidDetail
+{
+    constexpr uint32_t ParseHex(std::string_view text, size_t position, size_t digits)
+    {
+        if (position + digits > text.size())
+            throw std::invalid_argument("GUID is too short");
+
+        uint32_t value = 0;
+        for (size_t i = position; i < position + digits; ++i)
+        {
+            const auto c = text[i];
+            uint32_t digit = 0;
+            if (c >= '0' && c <= '9')
+                digit = static_cast<uint32_t>(c - '0');
+            else if (c >= 'a' && c <= 'f')
+                digit = static_cast<uint32_t>(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F')
+                digit = static_cast<uint32_t>(c - 'A' + 10);
+            else
+                throw std::invalid_argument("GUID contains a character that is not a hex digit");
+
+            value = value * 16 + digit;
+        }
+        return value;
+    }
+
+    constexpr void ExpectDash(std::string_view text, size_t position)
+    {
+        if (position >= text.size() || text[position] != '-')
+            throw std::invalid_argument("GUID is missing a dash");
+    }
+}
+
+/** Parse a GUID in the registry format 'xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx', with or without
+ * braces. Throws std::invalid_argument if the text is not a GUID, which makes the program
+ * ill-formed when called in a constant expression. */
+constexpr GuidValue ParseGuid(std::string_view text)
+{
+    if (text.size() == 38 && text.front() == '{' && text.back() == '}')
+        text = text.substr(1, 36);
+
+    if (text.size() != 36)
+        throw std::invalid_argument("GUID must have 36 characters without braces");
+
+    GuidValue guid;
+    guid.data1 = GuidDetail::ParseHex(text, 0, 8);
+    GuidDetail::ExpectDash(text, 8);
+    guid.data2 = static_cast<uint16_t>(GuidDetail::ParseHex(text, 9, 4));
+    GuidDetail::ExpectDash(text, 13);
+    guid.data3 = static_cast<uint16_t>(GuidDetail::ParseHex(text, 14, 4));
+    GuidDetail::ExpectDash(text, 18);
+    guid.data4[0] = static_cast<uint8_t>(GuidDetail::ParseHex(text, 19, 2));
+    guid.data4[1] = static_cast<uint8_t>(GuidDetail::ParseHex(text, 21, 2));
+    GuidDetail::ExpectDash(text, 23);
+    for (size_t i = 0; i < 6; ++i)
+        guid.data4[2 + i] = static_cast<uint8_t>(GuidDetail::ParseHex(text, 24 + 2 * i, 2));
+
+    return guid;
+}
+
+/** Convert anything with the fields of the GUID structure of Windows, such as a CLSID or an IID */
+template <typename Guid>
+constexpr GuidValue ToGuidValue(const Guid& guid) noexcept
+{
+    GuidValue value;
+    value.data1 = static_cast<uint32_t>(guid.Data1);
+    value.data2 = guid.Data2;
+    value.data3 = guid.Data3;
+    for (size_t i = 0; i < value.data4.size(); ++i)
+        value.data4[i] = guid.Data4[i];
+    return value;
+}
+
+/** 64 bit FNV-1a hash of the bytes of the GUID, in the order they appear in the text format */
+constexpr uint64_t HashGuid(const GuidValue& guid) noexcept
+{
+    uint64_t hash = 14695981039346656037ull;
+    const auto add = [&hash](uint8_t byte) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    };
+
+    for (int shift = 24; shift >= 0; shift -= 8)
+        add(static_cast<uint8_t>(guid.data1 >> shift));
+    add(static_cast<uint8_t>(guid.data2 >> 8));
+    add(static_cast<uint8_t>(guid.data2));
+    add(static_cast<uint8_t>(guid.data3 >> 8));
+    add(static_cast<uint8_t>(guid.data3));
+    for (const auto byte : guid.data4)
+        add(byte);
+
+    return hash;
+}
+
+namespace std
+{
+    template <>
+    struct hash<GuidValue>
+    {
+        size_t operator()(const GuidValue& guid) const noexcept
+        {
+            return static_cast<size_t>(HashGuid(guid));
+        }
+    };
+}
+
+template <typename T>
+struct GuidTableEntry
+{
+    GuidValue guid;
+    T value;
+};
+
+/** Map from GUID to value that can be built at compile time, such as the class objects of a dll.
+ *
+ * The entries are sorted when the table is constructed, and Find is a binary search, so
+ * looking up a GUID takes log2(N) comparisons without touching the heap. Duplicate GUIDs
+ * throw std::invalid_argument, which fails the build for a constexpr table. */
+template <typename T, size_t N>
+class GuidTable final
+{
+public:
+    constexpr explicit GuidTable(const GuidTableEntry<T> (&entries)[N])
+        : m_entries{}
+    {
+        // Insertion sort, since std::sort is not constexpr before C++20
+        for (size_t i = 0; i < N; ++i)
+        {
+            auto position = i;
+            while (position > 0 && entries[i].guid < m_entries[position - 1].guid)
+            {
+                m_entries[position] = m_entries[position - 1];
+                --position;
+            }
+            m_entries[position] = entries[i];
+        }
+
+        for (size_t i = 1; i < N; ++i)
+        {
+            if (m_entries[i - 1].guid == m_entries[i].guid)
+                throw std::invalid_argument("GuidTable contains the same GUID twice");
+        }
+    }
+
+    /** The value of the GUID, or nullptr if the GUID is not in the table */
+    constexpr const T* Find(const GuidValue& guid) const noexcept
+    {
+        size_t first = 0;
+        size_t count = N;
+        while (count > 0)
+        {
+            const auto step = count / 2;
+            if (m_entries[first + step].guid < guid)
+            {
+                first += step + 1;
+                count -= step + 1;
+            }
+            else
+            {
+                count = step;
+            }
+        }
+
+        if (first < N && m_entries[first].guid == guid)
+            return &m_entries[first].value;
+        return nullptr;
+    }
+
+    static constexpr size_t Size() noexcept
+    {
+        return N;
+    }
+
+private:
+    std::array<GuidTableEntry<T>, N> m_entries;
+};
+
+/** Deduce the size of the table from the number of entries */
+template <typename T, size_t N>
+constexpr GuidTable<T, N> MakeGuidTable(const GuidTableEntry<T> (&entries)[N])
+{
+    return GuidTable<T, N>{entries};
+}
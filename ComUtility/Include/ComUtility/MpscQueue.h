@@ -0,0 +1,159 @@
+#pragma once
+#include "ObjectPool.h"
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/** Lock-free multi-producer/single-consumer queue.
+ *
+ * Producers push nodes onto an intrusive stack with a single compare-and-swap.
+ * The consumer detaches the whole stack with one atomic exchange and reverses it,
+ * so elements are consumed in the order they were pushed. Neither side takes a lock.
+ *
+ * Nodes are allocated from an ObjectPool, so pushing does not touch the heap in steady state.
+ *
+ * Any number of threads may call push_back concurrently, but only one thread at a
+ * time may call consume_all and empty. */
+template <typename T>
+class MpscQueue
+{
+    enum class State : unsigned char
+    {
+        Pending,   ///< Waiting in the queue
+        Claimed,   ///< Taken by the consumer
+        Cancelled, ///< Reverted by the producer, the consumer will discard it
+    };
+
+    struct Node
+    {
+        explicit Node(T&& elem) : value(std::move(elem)) {}
+
+        T value;
+        Node* next = nullptr;
+        std::atomic<State> state{State::Pending};
+        std::atomic<int> references{2}; ///< Shared by the consumer and the producer's ticket
+    };
+
+    static void Release(Node* node)
+    {
+        if (node->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            ObjectPool<Node>::Delete(node);
+    }
+
+public:
+    /** Handle to a newly added element that allows the producer to revert it */
+    class Ticket
+    {
+    public:
+        Ticket(Ticket&& other) noexcept : m_node(std::exchange(other.m_node, nullptr)) {}
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+        Ticket& operator=(Ticket&&) = delete;
+
+        ~Ticket()
+        {
+            if (m_node)
+                Release(m_node);
+        }
+
+        /** Revert the element. This gives the same strong guarantee as ThreadSafeQueue::pop_back,
+         * unless the consumer already took the element. Returns false in that case, and the element
+         * is consumed as if it was never reverted. */
+        bool revert()
+        {
+            auto expected = State::Pending;
+            return m_node->state.compare_exchange_strong(expected, State::Cancelled, std::memory_order_acq_rel);
+        }
+
+    private:
+        friend class MpscQueue;
+        explicit Ticket(Node* node) : m_node(node) {}
+
+        Node* m_node;
+    };
+
+    MpscQueue() = default;
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    ~MpscQueue()
+    {
+        consume_all([](T&) {});
+    }
+
+    Ticket push_back(T elem)
+    {
+        auto node = ObjectPool<Node>::New(std::move(elem));
+        node->next = m_head.load(std::memory_order_relaxed);
+        while (!m_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+        return Ticket{node};
+    }
+
+    /** Consume all elements in the queue in FIFO order. Must only be called from the consumer thread.
+     * Returns the number of consumed elements.
+     *
+     * If the consumer throws, it must leave the element as it was. The element and the ones after
+     * it stay in the queue, ahead of elements pushed later, and the exception is rethrown. */
+    template <typename Consumer>
+    size_t consume_all(Consumer&& consumer)
+    {
+        // Detach the stack, and reverse it to restore insertion order
+        Node* reversed = nullptr;
+        auto node = m_head.exchange(nullptr, std::memory_order_acquire);
+        while (node)
+        {
+            const auto next = node->next;
+            node->next = reversed;
+            reversed = node;
+            node = next;
+        }
+
+        // Elements left behind by a consumer that threw are older than the detached ones
+        if (m_leftover)
+        {
+            auto last = m_leftover;
+            while (last->next)
+                last = last->next;
+            last->next = reversed;
+            reversed = std::exchange(m_leftover, nullptr);
+        }
+
+        size_t consumed = 0;
+        while (reversed)
+        {
+            node = std::exchange(reversed, reversed->next);
+
+            auto expected = State::Pending;
+            if (node->state.compare_exchange_strong(expected, State::Claimed, std::memory_order_acq_rel))
+            {
+                try
+                {
+                    consumer(node->value);
+                }
+                catch (...)
+                {
+                    // Not consumed after all, so the producer may revert it again
+                    node->state.store(State::Pending, std::memory_order_release);
+                    node->next = reversed;
+                    m_leftover = node;
+                    throw;
+                }
+                ++consumed;
+            }
+
+            Release(node);
+        }
+        return consumed;
+    }
+
+    bool empty() const
+    {
+        return !m_leftover && m_head.load(std::memory_order_relaxed) == nullptr;
+    }
+
+private:
+    std::atomic<Node*> m_head{nullptr}; ///< Most recently pushed node
+    Node* m_leftover = nullptr;         ///< Detached nodes that a throwing consumer did not get to, oldest first. Only used by the consumer.
+};
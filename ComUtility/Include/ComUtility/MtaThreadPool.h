@@ -0,0 +1,15 @@
+#pragma once
+#include "Utility.h"
+#include "WorkStealingPool.h"
+#include <thread>
+
+/** Work stealing thread pool where every worker thread is initialized into the
+ * multithreaded apartment once, when the pool is created */
+class MtaThreadPool final : public WorkStealingPool<ComRuntime>
+{
+public:
+    explicit MtaThreadPool(size_t workerCount = std::thread::hardware_concurrency())
+        : WorkStealingPool(workerCount, Apartment::MultiThreaded)
+    {
+    }
+};
@@ -0,0 +1,287 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <thread>
+#include <utility>
+
+/** Thread-safe pool of fixed size blocks for objects of type T.
+ *
+ * Each thread keeps a cache of free blocks, so allocation and deallocation normally
+ * do not touch shared state. When a thread has freed more than a batch of blocks, the
+ * batch is handed over to a shared lock-free list, where threads that run out of
+ * blocks can take all of them at once. This suits producer/consumer patterns where
+ * objects are allocated on one thread and released on another.
+ *
+ * Blocks are only returned to the heap by ReleaseMemory, so the pool grows to the peak
+ * number of live objects. The pool and the thread caches live in the module that uses
+ * them, so a dll that allocates from a pool calls ReleaseMemory when it is unloaded.
+ * Otherwise the blocks of the pool leak with every load and unload.
+ *
+ * Objects may be deallocated after the cache of the thread has been destroyed, for
+ * instance by the destructor of another thread local object. The block then goes
+ * straight to the shared list. */
+template <typename T>
+class ObjectPool final
+{
+    union Block
+    {
+        Block* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    /** Number of freed blocks a thread keeps before handing them to the shared list */
+    static constexpr size_t BatchSize = 64;
+
+    /** Singly linked list of blocks */
+    struct BlockList
+    {
+        Block* head = nullptr;
+        Block* tail = nullptr;
+        size_t count = 0;
+
+        void Push(Block* block) noexcept
+        {
+            block->next = head;
+            head = block;
+            if (!tail)
+                tail = block;
+            ++count;
+        }
+
+        Block* Pop() noexcept
+        {
+            const auto block = head;
+            head = block->next;
+            if (!head)
+                tail = nullptr;
+            --count;
+            return block;
+        }
+
+        bool Empty() const noexcept
+        {
+            return head == nullptr;
+        }
+    };
+
+    struct ThreadCache
+    {
+        BlockList freed;    ///< Blocks released by this thread
+        Block* shared = nullptr; ///< Blocks taken from the shared list
+        ThreadCache* previous = nullptr; ///< Links of the registry of caches
+        ThreadCache* next = nullptr;
+
+        ThreadCache() noexcept
+        {
+            const RegistryLock lock;
+            auto& registry = Caches();
+            next = registry.head;
+            if (next)
+                next->previous = this;
+            registry.head = this;
+        }
+
+        ~ThreadCache()
+        {
+            {
+                const RegistryLock lock;
+                if (previous)
+                    previous->next = next;
+                else
+                    Caches().head = next;
+                if (next)
+                    next->previous = previous;
+            }
+
+            // Hand remaining blocks over to other threads when this thread exits
+            HandOver(freed);
+
+            BlockList rest;
+            while (shared)
+                rest.Push(std::exchange(shared, shared->next));
+            HandOver(rest);
+
+            CacheDestroyed() = true;
+        }
+    };
+
+    /** The cache of the current thread, or nullptr if it has been destroyed at thread exit */
+    static ThreadCache* Cache() noexcept
+    {
+        if (CacheDestroyed())
+            return nullptr;
+
+        static thread_local ThreadCache cache;
+        return &cache;
+    }
+
+    /** Trivially destructible, so that it can be read while other thread locals are destroyed */
+    static bool& CacheDestroyed() noexcept
+    {
+        static thread_local bool destroyed = false;
+        return destroyed;
+    }
+
+    /** The caches of all threads, so that ReleaseMemory can empty them. Trivially destructible
+     * as well, since caches of exiting threads unregister during static destruction. */
+    struct Registry
+    {
+        std::atomic<bool> locked;
+        ThreadCache* head;
+    };
+
+    static Registry& Caches() noexcept
+    {
+        static Registry registry{false, nullptr};
+        return registry;
+    }
+
+    /** Only held while a thread registers or unregisters its cache, and by ReleaseMemory */
+    class RegistryLock final
+    {
+    public:
+        RegistryLock() noexcept
+        {
+            while (Caches().locked.exchange(true, std::memory_order_acquire))
+                std::this_thread::yield();
+        }
+
+        ~RegistryLock()
+        {
+            Caches().locked.store(false, std::memory_order_release);
+        }
+
+        RegistryLock(const RegistryLock&) = delete;
+        RegistryLock& operator=(const RegistryLock&) = delete;
+    };
+
+    static std::atomic<size_t>& HeapBlocks() noexcept
+    {
+        static std::atomic<size_t> count{0};
+        return count;
+    }
+
+    static Block* NewBlock() noexcept
+    {
+        const auto block = new (std::nothrow) Block;
+        if (block)
+            HeapBlocks().fetch_add(1, std::memory_order_relaxed);
+        return block;
+    }
+
+    static void FreeBlocks(Block* block) noexcept
+    {
+        while (block)
+        {
+            delete std::exchange(block, block->next);
+            HeapBlocks().fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    static void HandOver(BlockList& list) noexcept
+    {
+        if (list.Empty())
+            return;
+
+        auto& sharedHead = SharedHead();
+        list.tail->next = sharedHead.load(std::memory_order_relaxed);
+        while (!sharedHead.compare_exchange_weak(list.tail->next, list.head, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+        list = BlockList{};
+    }
+
+    /** Blocks handed over by threads. Taken as a whole with exchange, which avoids the ABA problem. */
+    static std::atomic<Block*>& SharedHead() noexcept
+    {
+        static std::atomic<Block*> head{nullptr};
+        return head;
+    }
+
+public:
+    ObjectPool() = delete;
+
+    /** Allocate uninitialized memory for one T. Returns nullptr if out of memory. */
+    static void* Allocate() noexcept
+    {
+        const auto cache = Cache();
+        if (!cache)
+            return NewBlock();
+
+        if (!cache->freed.Empty())
+            return cache->freed.Pop();
+
+        if (!cache->shared)
+            cache->shared = SharedHead().exchange(nullptr, std::memory_order_acquire);
+
+        if (cache->shared)
+            return std::exchange(cache->shared, cache->shared->next);
+
+        return NewBlock();
+    }
+
+    /** Return memory obtained from Allocate to the pool */
+    static void Deallocate(void* memory) noexcept
+    {
+        const auto cache = Cache();
+        if (!cache)
+        {
+            BlockList single;
+            single.Push(static_cast<Block*>(memory));
+            HandOver(single);
+            return;
+        }
+
+        cache->freed.Push(static_cast<Block*>(memory));
+        if (cache->freed.count >= BatchSize)
+            HandOver(cache->freed);
+    }
+
+    /** Return all free blocks to the heap, also the ones in the caches of other threads.
+     * For a dll that allocates from the pool, when it is unloaded. Must only be called when
+     * no object of the pool is alive, and no other thread uses the pool. */
+    static void ReleaseMemory() noexcept
+    {
+        const RegistryLock lock;
+        for (auto cache = Caches().head; cache; cache = cache->next)
+        {
+            FreeBlocks(std::exchange(cache->freed, BlockList{}).head);
+            FreeBlocks(std::exchange(cache->shared, nullptr));
+        }
+        FreeBlocks(SharedHead().exchange(nullptr, std::memory_order_acquire));
+    }
+
+    /** Number of blocks the pool has taken from the heap and not given back, whether they
+     * are in use or not */
+    static size_t BlockCount() noexcept
+    {
+        return HeapBlocks().load(std::memory_order_relaxed);
+    }
+
+    /** Construct a T in pooled memory. Throws std::bad_alloc if out of memory. */
+    template <typename... Args>
+    static T* New(Args&&... args)
+    {
+        const auto memory = Allocate();
+        if (!memory)
+            throw std::bad_alloc();
+
+        try
+        {
+            return new (memory) T(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            Deallocate(memory);
+            throw;
+        }
+    }
+
+    /** Destroy an object created with New */
+    static void Delete(T* object) noexcept
+    {
+        object->~T();
+        Deallocate(object);
+    }
+};
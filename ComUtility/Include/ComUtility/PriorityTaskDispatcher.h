@@ -0,0 +1,479 @@
+#pragma once
+#include "MpscQueue.h"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/** Lane of a PriorityTaskDispatcher */
+enum class TaskPriority
+{
+    Interactive, ///< Short, latency critical tasks that someone is waiting for
+    Background,  ///< Long running or bulk work, that yields to interactive tasks
+};
+
+/** What a bounded PriorityTaskDispatcher does with a task submitted when it is full */
+enum class OverflowPolicy
+{
+    Block,      ///< Wait until the consumer has made room. Tasks submitted by the consumer thread itself never block.
+    FailFast,   ///< Throw std::system_error with std::errc::resource_unavailable_try_again
+    DropOldest, ///< Accept the task, and drop the oldest tasks when the consumer picks them up, background tasks first
+};
+
+/** Bound and watermarks for the number of queued tasks in a PriorityTaskDispatcher */
+struct QueueLimits
+{
+    size_t capacity = 0;                                ///< Queued tasks over both lanes. Zero means unbounded.
+    OverflowPolicy overflow = OverflowPolicy::Block;
+
+    /** onHighWatermark is called when the number of queued tasks reaches highWatermark,
+     * and onLowWatermark when it has fallen back to lowWatermark. Use them to throttle
+     * producers before the queue fills up. The callbacks alternate, are called on the thread
+     * that submitted or ran the task that crossed the watermark, and must not throw.
+     * A highWatermark of zero disables the callbacks. */
+    size_t highWatermark = 0;
+    size_t lowWatermark = 0;
+    std::function<void()> onHighWatermark{};
+    std::function<void()> onLowWatermark{};
+};
+
+/** Queue of tasks for a single consumer thread with an interactive and a background lane.
+ *
+ * Wakeups are coalesced: both lanes share one wakeup, the consumer is only signaled when
+ * no wakeup is in flight already, and each wakeup drains every pending task in one pass.
+ * A burst of tasks therefore costs one wakeup instead of one per task. The Wakeup type
+ * decides how the consumer thread is notified. It must provide a Signal() function that
+ * throws if the consumer could not be notified.
+ *
+ * When draining, interactive tasks run first. Before each background task, interactive
+ * tasks that were submitted in the meantime are picked up, so an interactive task waits
+ * for at most one background task. To keep a flood of interactive tasks from starving
+ * the background lane, at most interactiveBurst interactive tasks run in a row while
+ * background tasks are waiting.
+ *
+ * A drain runs the background tasks that were queued when it started. Tasks submitted
+ * while draining signal a new wakeup, so the consumer gets to serve other work, such as
+ * window messages, in between.
+ *
+ * The number of queued tasks can be bounded with QueueLimits. The queue itself is lock-free
+ * and can only be taken from by the consumer, so with OverflowPolicy::DropOldest the queue
+ * may exceed its capacity until the consumer drains it.
+ *
+ * Shutdown closes the dispatcher, and hands every pending task back to the consumer
+ * without running it, so that their owners can be told deterministically. */
+template <typename Task, typename Wakeup>
+class PriorityTaskDispatcher
+{
+public:
+    static constexpr size_t LaneCount = 2;
+
+    template <typename... Args>
+    PriorityTaskDispatcher(size_t interactiveBurst, QueueLimits limits, Args&&... args)
+        : m_interactiveBurst(interactiveBurst > 0 ? interactiveBurst : 1)
+        , m_limits(std::move(limits))
+        , m_wakeup(std::forward<Args>(args)...)
+    {
+    }
+
+    /** Add a task to a lane, and wake up the consumer if it is not already woken up. If the
+     * wakeup fails, the task is reverted and the exception from the wakeup is rethrown.
+     * When the dispatcher is full, the overflow policy decides whether to block or throw. */
+    void Submit(TaskPriority priority, Task task)
+    {
+        Push(priority, std::move(task), true);
+    }
+
+    /** Same as Submit, but the task is accepted even when the dispatcher is full, so that it
+     * never blocks or throws because of the limits. For work that has been accepted already,
+     * like resuming a coroutine, which must neither be refused nor wait for other work. The
+     * task still counts towards the limits, and can still be dropped by OverflowPolicy::DropOldest.
+     * Throws if the dispatcher is shut down, or if the wakeup fails. */
+    void SubmitUnbounded(TaskPriority priority, Task task)
+    {
+        Push(priority, std::move(task), false);
+    }
+
+    /** Run pending tasks in priority order. Must be called from the consumer thread when it
+     * is woken up, and the consumer must not throw. Returns the number of tasks that were run. */
+    template <typename Consumer>
+    size_t Drain(Consumer&& consumer)
+    {
+        return Drain(std::forward<Consumer>(consumer), [](Task&) {});
+    }
+
+    /** Same as Drain, but tasks dropped by OverflowPolicy::DropOldest are passed to dropped
+     * instead of being destroyed silently. dropped must not throw either. */
+    template <typename Consumer, typename Dropped>
+    size_t Drain(Consumer&& consumer, Dropped&& dropped)
+    {
+        m_consumer.store(std::this_thread::get_id(), std::memory_order_relaxed);
+
+        // Clear the flag before draining, so that tasks submitted while we are
+        // draining will cause a new wakeup. The acquire makes the tasks of the
+        // producer that set the flag visible to the drain.
+        m_wakeupPending.exchange(false, std::memory_order_acq_rel);
+
+        auto& interactive = m_lanes[Index(TaskPriority::Interactive)];
+        auto& background = m_lanes[Index(TaskPriority::Background)];
+        Collect(interactive);
+        Collect(background);
+        DropOverflow(dropped);
+
+        size_t ran = 0;
+        for (;;)
+        {
+            for (size_t burst = 0; interactive.HasReady() && (burst < m_interactiveBurst || !background.HasReady()); ++burst, ++ran)
+                Take(interactive, consumer);
+
+            if (!background.HasReady())
+                return ran;
+
+            Take(background, consumer);
+            ++ran;
+
+            // Let interactive tasks submitted meanwhile jump ahead of the remaining background tasks
+            if (!interactive.queue.empty())
+            {
+                Collect(interactive);
+                DropOverflow(dropped);
+            }
+        }
+    }
+
+    /** Stop accepting tasks, and pass all pending tasks to dropped. This includes tasks that
+     * are submitted concurrently, so no task is left behind. Afterwards, Submit throws
+     * std::system_error with std::errc::operation_canceled, also in producers that are
+     * blocked on a full queue. Must be called from the consumer thread, and dropped must not
+     * throw. Returns the number of dropped tasks. */
+    template <typename Dropped>
+    size_t Shutdown(Dropped&& dropped)
+    {
+        m_closed.store(true, std::memory_order_seq_cst);
+        {
+            std::lock_guard guard(m_slotMutex);
+            m_slotFreed.notify_all();
+        }
+
+        size_t count = 0;
+        for (;;)
+        {
+            for (auto& lane : m_lanes)
+            {
+                Collect(lane);
+                for (; lane.HasReady(); ++count)
+                    Take(lane, dropped);
+            }
+
+            // A producer that took a slot before the dispatcher closed is about to push its task
+            if (m_queuedCount.load(std::memory_order_seq_cst) == 0)
+                return count;
+            std::this_thread::yield();
+        }
+    }
+
+    /** Number of tasks in all lanes that are submitted, but not yet started. This is a
+     * snapshot that may be outdated as soon as it is returned. */
+    size_t PendingCount() const
+    {
+        return m_queuedCount.load(std::memory_order_relaxed);
+    }
+
+    size_t PendingCount(TaskPriority priority) const
+    {
+        return m_lanes[Index(priority)].pendingCount.load(std::memory_order_relaxed);
+    }
+
+    Wakeup& GetWakeup()
+    {
+        return m_wakeup;
+    }
+
+private:
+    struct Lane
+    {
+        bool HasReady() const
+        {
+            return next < ready.size();
+        }
+
+        MpscQueue<Task> queue;                  ///< Tasks that are not yet picked up by the consumer
+        std::vector<Task> ready;                ///< Tasks picked up by the consumer. Only used on the consumer thread.
+        size_t next = 0;                        ///< Index of the next task to run in ready
+        std::atomic<size_t> pendingCount = 0;   ///< Number of tasks waiting to be run
+    };
+
+    static constexpr size_t Index(TaskPriority priority)
+    {
+        return static_cast<size_t>(priority);
+    }
+
+    bool IsFull(size_t queuedCount) const
+    {
+        return m_limits.capacity != 0 && queuedCount > m_limits.capacity;
+    }
+
+    /** Queue a task in its lane, and wake up the consumer. Bounded tasks are subject to the limits */
+    void Push(TaskPriority priority, Task task, bool bounded)
+    {
+        auto& lane = m_lanes[Index(priority)];
+
+        // Count the task before it becomes visible to the consumer, so the count never underflows
+        Reserve(bounded);
+        lane.pendingCount.fetch_add(1, std::memory_order_relaxed);
+        auto ticket = PushBack(lane, std::move(task));
+
+        if (m_wakeupPending.exchange(true, std::memory_order_acq_rel))
+            return; // The consumer will pick up the task when it serves the pending wakeup
+
+        try
+        {
+            m_wakeup.Signal();
+        }
+        catch (...)
+        {
+            // If the revert fails, the consumer already took the task while
+            // draining for another wakeup, so the task is not lost.
+            const auto reverted = ticket.revert();
+            if (reverted)
+            {
+                lane.pendingCount.fetch_sub(1, std::memory_order_relaxed);
+                Release();
+            }
+
+            // Allow the next producer to try again
+            m_wakeupPending.store(false, std::memory_order_release);
+
+            // Producers that submitted while we were signaling saw the flag, and did not signal
+            RetryWakeup();
+
+            if (reverted)
+                throw;
+        }
+    }
+
+    /** Take a slot for a new task, according to the overflow policy if the task is bounded */
+    void Reserve(bool bounded)
+    {
+        // Sequentially consistent, to pair with the check for blocked producers in Release
+        auto queuedCount = m_queuedCount.fetch_add(1, std::memory_order_seq_cst) + 1;
+        if (bounded && IsFull(queuedCount) && m_limits.overflow != OverflowPolicy::DropOldest)
+        {
+            Unreserve();
+            if (m_limits.overflow == OverflowPolicy::FailFast)
+                throw std::system_error(std::make_error_code(std::errc::resource_unavailable_try_again), "Task queue is full");
+
+            queuedCount = WaitForSlot();
+        }
+
+        // Pairs with Shutdown, so that either the producer sees that the dispatcher is
+        // closed, or Shutdown sees the slot and waits for the task
+        if (m_closed.load(std::memory_order_seq_cst))
+        {
+            Unreserve();
+            throw std::system_error(std::make_error_code(std::errc::operation_canceled), "Task queue is shut down");
+        }
+
+        if (m_limits.highWatermark != 0 && queuedCount >= m_limits.highWatermark &&
+            !m_aboveHighWatermark.exchange(true, std::memory_order_acq_rel) && m_limits.onHighWatermark)
+        {
+            m_limits.onHighWatermark();
+        }
+    }
+
+    /** Block until a slot is free or the dispatcher is shut down, and take a slot. Returns the
+     * number of queued tasks with the new task. */
+    size_t WaitForSlot()
+    {
+        // The consumer would wait for itself
+        if (std::this_thread::get_id() == m_consumer.load(std::memory_order_relaxed))
+            return m_queuedCount.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+        std::unique_lock lock(m_slotMutex);
+        m_blockedCount.fetch_add(1, std::memory_order_seq_cst);
+        size_t queuedCount = 0;
+        m_slotFreed.wait(lock, [this, &queuedCount] {
+            if (m_closed.load(std::memory_order_seq_cst))
+            {
+                queuedCount = m_queuedCount.fetch_add(1, std::memory_order_seq_cst) + 1;
+                return true; // Reserve gives the slot back and throws
+            }
+
+            auto current = m_queuedCount.load(std::memory_order_seq_cst);
+            while (!IsFull(current + 1))
+            {
+                if (m_queuedCount.compare_exchange_weak(current, current + 1, std::memory_order_seq_cst))
+                {
+                    queuedCount = current + 1;
+                    return true;
+                }
+            }
+            return false;
+        });
+        m_blockedCount.fetch_sub(1, std::memory_order_relaxed);
+        return queuedCount;
+    }
+
+    /** Give back a slot, and wake up a blocked producer. Returns the number of queued tasks left. */
+    size_t Unreserve()
+    {
+        const auto queuedCount = m_queuedCount.fetch_sub(1, std::memory_order_seq_cst) - 1;
+        if (m_blockedCount.load(std::memory_order_seq_cst) != 0)
+        {
+            std::lock_guard guard(m_slotMutex);
+            m_slotFreed.notify_one();
+        }
+        return queuedCount;
+    }
+
+    /** Give back the slot of a task that has been started, dropped or reverted */
+    void Release()
+    {
+        const auto queuedCount = Unreserve();
+        if (m_limits.highWatermark != 0 && queuedCount <= m_limits.lowWatermark &&
+            m_aboveHighWatermark.exchange(false, std::memory_order_acq_rel) && m_limits.onLowWatermark)
+        {
+            m_limits.onLowWatermark();
+        }
+    }
+
+    /** Signal the consumer if tasks are queued and no wakeup is in flight. A second failure
+     * is not reported, since the tasks belong to other producers that have already returned. */
+    void RetryWakeup() noexcept
+    {
+        if (m_queuedCount.load(std::memory_order_seq_cst) == 0 || m_wakeupPending.exchange(true, std::memory_order_acq_rel))
+            return;
+
+        try
+        {
+            m_wakeup.Signal();
+        }
+        catch (...)
+        {
+            m_wakeupPending.store(false, std::memory_order_release);
+        }
+    }
+
+    typename MpscQueue<Task>::Ticket PushBack(Lane& lane, Task&& task)
+    {
+        try
+        {
+            return lane.queue.push_back(std::move(task));
+        }
+        catch (...)
+        {
+            lane.pendingCount.fetch_sub(1, std::memory_order_relaxed);
+            Release();
+            throw;
+        }
+    }
+
+    /** Move the queued tasks of a lane over to its ready tasks. The ready tasks keep their
+     * capacity between drains, so this does not allocate in steady state. If they can not
+     * grow, the tasks that did not fit stay queued, and the consumer is woken up again to
+     * pick them up. */
+    void Collect(Lane& lane) noexcept
+    {
+        if (!lane.HasReady())
+        {
+            lane.ready.clear();
+            lane.next = 0;
+        }
+
+        try
+        {
+            // Make room for every task that is counted, so that moving them over does not
+            // allocate. Only tasks pushed after the count was read may need to grow the vector.
+            lane.ready.reserve(lane.ready.size() + lane.pendingCount.load(std::memory_order_relaxed));
+            lane.queue.consume_all([&lane](Task& task) {
+                lane.ready.push_back(std::move(task));
+            });
+        }
+        catch (const std::bad_alloc&)
+        {
+            // push_back left the task that did not fit as it was, so consume_all kept it queued
+            RetryWakeup();
+        }
+    }
+
+    /** Drop the oldest picked up tasks while the dispatcher is over capacity, background tasks first */
+    template <typename Dropped>
+    void DropOverflow(Dropped& dropped)
+    {
+        if (m_limits.overflow != OverflowPolicy::DropOldest)
+            return;
+
+        for (const auto priority : {TaskPriority::Background, TaskPriority::Interactive})
+        {
+            auto& lane = m_lanes[Index(priority)];
+            while (lane.HasReady() && IsFull(m_queuedCount.load(std::memory_order_relaxed)))
+                Take(lane, dropped);
+        }
+    }
+
+    /** Remove the next ready task of a lane, and pass it on */
+    template <typename Consumer>
+    void Take(Lane& lane, Consumer& consumer)
+    {
+        auto task = std::move(lane.ready[lane.next++]);
+        lane.pendingCount.fetch_sub(1, std::memory_order_relaxed);
+        Release();
+        consumer(task);
+    }
+
+    std::array<Lane, LaneCount> m_lanes;
+    const size_t m_interactiveBurst;                ///< Interactive tasks that may run in a row while background tasks wait
+    const QueueLimits m_limits;
+    std::atomic<size_t> m_queuedCount = 0;          ///< Number of tasks in all lanes, used for the limits
+    std::atomic<bool> m_aboveHighWatermark = false; ///< True from the high watermark until the low watermark is reached
+    std::atomic<std::thread::id> m_consumer;        ///< The thread that drains, which must never block in Submit
+    std::atomic<bool> m_wakeupPending = false;      ///< True when the consumer has been signaled, but has not started draining
+    std::atomic<bool> m_closed = false;             ///< Set by Shutdown
+    std::atomic<size_t> m_blockedCount = 0;         ///< Number of producers waiting for a free slot
+    std::mutex m_slotMutex;                         ///< Protects blocked producers
+    std::condition_variable m_slotFreed;
+    Wakeup m_wakeup;                                ///< Notifies the consumer thread
+};
+
+/** Portable wakeup that lets a consumer thread wait on a condition variable */
+class ConditionVariableWakeup
+{
+public:
+    void Signal()
+    {
+        {
+            std::lock_guard guard(m_mutex);
+            m_signaled = true;
+            ++m_signalCount;
+        }
+        m_condition.notify_one();
+    }
+
+    /** Block until signaled */
+    void Wait()
+    {
+        std::unique_lock lock(m_mutex);
+        m_condition.wait(lock, [this] { return m_signaled; });
+        m_signaled = false;
+    }
+
+    /** Number of times the consumer has been signaled */
+    size_t SignalCount()
+    {
+        std::lock_guard guard(m_mutex);
+        return m_signalCount;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_signaled = false;
+    size_t m_signalCount = 0;
+};
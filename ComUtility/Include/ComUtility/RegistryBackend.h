@@ -0,0 +1,365 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <optional>
+#include <set>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/** A string value under a registry key. An empty name is the default value of the key */
+struct RegistryValue
+{
+    std::wstring name;
+    std::wstring data;
+};
+
+/** A registry key, and all values to write under it */
+struct RegistryKeyWrite
+{
+    std::wstring path;
+    std::vector<RegistryValue> values;
+};
+
+/** Where registration writes its keys and values.
+ *
+ * Paths are relative to the root of the backend, with components separated by backslashes,
+ * and compare case insensitive, like registry paths do. */
+class RegistryBackend
+{
+public:
+    virtual ~RegistryBackend() = default;
+
+    /** Create the key and any missing parents, and set all values of the key with one open key */
+    virtual std::error_code WriteKey(const RegistryKeyWrite& key) = 0;
+
+    /** Delete the key with all its subkeys and values. A missing key is not an error */
+    virtual std::error_code DeleteTree(std::wstring_view path) = 0;
+};
+
+/** Registry path with ASCII letters in lower case, for comparing paths */
+inline std::wstring FoldRegistryPath(std::wstring_view path)
+{
+    std::wstring folded{path};
+    for (auto& c : folded)
+    {
+        if (c >= L'A' && c <= L'Z')
+            c = static_cast<wchar_t>(c - L'A' + L'a');
+    }
+    return folded;
+}
+
+/** Registry writes and deletes, grouped by key.
+ *
+ * Values are added one at a time, in any order, but are written with one WriteKey call per
+ * key, in the order the keys were first added. Deleting a tree also deletes its subkeys, so
+ * trees below other deleted trees, and repeated trees, are only deleted once. */
+class RegistryBatch final
+{
+public:
+    /** Create the key without setting any values */
+    void CreateKey(std::wstring_view path)
+    {
+        KeyAt(path);
+    }
+
+    /** Set a value of the key. A later value with the same name replaces the earlier one */
+    void SetValue(std::wstring_view path, std::wstring_view name, std::wstring_view data)
+    {
+        auto& values = KeyAt(path).values;
+        const auto folded = FoldRegistryPath(name);
+        for (auto& value : values)
+        {
+            if (FoldRegistryPath(value.name) == folded)
+            {
+                value.data = data;
+                return;
+            }
+        }
+        values.push_back({std::wstring{name}, std::wstring{data}});
+    }
+
+    /** Delete the key and its subkeys when calling Delete */
+    void DeleteTree(std::wstring_view path)
+    {
+        const auto folded = FoldRegistryPath(path);
+        for (auto separator = folded.find(L'\\'); separator != std::wstring::npos; separator = folded.find(L'\\', separator + 1))
+        {
+            if (m_deletedRoots.count(folded.substr(0, separator)) != 0)
+                return;
+        }
+        if (!m_deletedRoots.insert(folded).second)
+            return;
+
+        // Trees below the new one become redundant
+        const auto prefix = folded + L'\\';
+        const auto first = m_deletedRoots.lower_bound(prefix);
+        auto last = first;
+        while (last != m_deletedRoots.end() && last->compare(0, prefix.size(), prefix) == 0)
+            ++last;
+        if (first != last)
+        {
+            m_deletedRoots.erase(first, last);
+            m_deletes.erase(std::remove_if(m_deletes.begin(), m_deletes.end(), [this](const std::wstring& root) {
+                                return m_deletedRoots.count(FoldRegistryPath(root)) == 0;
+                            }),
+                            m_deletes.end());
+        }
+        m_deletes.emplace_back(path);
+    }
+
+    /** Write all keys. Stops at the first failure */
+    std::error_code Write(RegistryBackend& backend) const
+    {
+        for (const auto& key : m_keys)
+        {
+            if (const auto error = backend.WriteKey(key))
+                return error;
+        }
+        return {};
+    }
+
+    /** Delete all trees. Stops at the first failure */
+    std::error_code Delete(RegistryBackend& backend) const
+    {
+        for (const auto& root : m_deletes)
+        {
+            if (const auto error = backend.DeleteTree(root))
+                return error;
+        }
+        return {};
+    }
+
+    const std::vector<RegistryKeyWrite>& Keys() const noexcept
+    {
+        return m_keys;
+    }
+
+    /** The trees that Delete deletes, without the redundant ones */
+    const std::vector<std::wstring>& DeletedTrees() const noexcept
+    {
+        return m_deletes;
+    }
+
+private:
+    RegistryKeyWrite& KeyAt(std::wstring_view path)
+    {
+        const auto [index, added] = m_index.try_emplace(FoldRegistryPath(path), m_keys.size());
+        if (added)
+            m_keys.push_back({std::wstring{path}, {}});
+        return m_keys[index->second];
+    }
+
+    std::vector<RegistryKeyWrite> m_keys;
+    std::unordered_map<std::wstring, size_t> m_index; ///< Folded path to position in m_keys
+    std::vector<std::wstring> m_deletes;
+    std::set<std::wstring> m_deletedRoots; ///< Folded paths of m_deletes
+};
+
+/** Registry that lives in memory, for testing and benchmarking registration without Windows.
+ *
+ * The content can be saved to and loaded from a stream in the text format of .reg files,
+ * without the header line, and with paths relative to the root of the registry. Only
+ * string values are supported. */
+class MemoryRegistry : public RegistryBackend
+{
+public:
+    std::error_code WriteKey(const RegistryKeyWrite& key) override
+    {
+        ++m_writeCount;
+        auto& values = CreateKey(key.path);
+        for (const auto& value : key.values)
+            values[FoldRegistryPath(value.name)] = value;
+        return {};
+    }
+
+    std::error_code DeleteTree(std::wstring_view path) override
+    {
+        ++m_deleteCount;
+        const auto folded = FoldRegistryPath(path);
+        m_keys.erase(folded);
+
+        // Keys that start with the path and a separator sort next to each other
+        const auto prefix = folded + L'\\';
+        for (auto key = m_keys.lower_bound(prefix); key != m_keys.end() && key->first.compare(0, prefix.size(), prefix) == 0;)
+            key = m_keys.erase(key);
+        return {};
+    }
+
+    bool HasKey(std::wstring_view path) const
+    {
+        return m_keys.count(FoldRegistryPath(path)) != 0;
+    }
+
+    std::optional<std::wstring> Value(std::wstring_view path, std::wstring_view name) const
+    {
+        const auto key = m_keys.find(FoldRegistryPath(path));
+        if (key == m_keys.end())
+            return std::nullopt;
+
+        const auto value = key->second.values.find(FoldRegistryPath(name));
+        if (value == key->second.values.end())
+            return std::nullopt;
+
+        return value->second.data;
+    }
+
+    size_t KeyCount() const noexcept
+    {
+        return m_keys.size();
+    }
+
+    /** Number of WriteKey calls, which is the number of times a real registry opens a key for writing */
+    size_t WriteCount() const noexcept
+    {
+        return m_writeCount;
+    }
+
+    /** Number of DeleteTree calls */
+    size_t DeleteCount() const noexcept
+    {
+        return m_deleteCount;
+    }
+
+    void Save(std::wostream& stream) const
+    {
+        for (const auto& [folded, key] : m_keys)
+        {
+            stream << L'[' << key.path << L"]\n";
+            for (const auto& [name, value] : key.values)
+            {
+                if (value.name.empty())
+                    stream << L'@';
+                else
+                    stream << Quote(value.name);
+                stream << L'=' << Quote(value.data) << L'\n';
+            }
+            stream << L'\n';
+        }
+    }
+
+    /** Add the keys and values of a stream written by Save. Returns std::errc::illegal_byte_sequence
+     * for lines that can not be parsed, and keeps the content that was read before */
+    std::error_code Load(std::wistream& stream)
+    {
+        std::map<std::wstring, RegistryValue>* values = nullptr;
+        std::wstring line;
+        while (std::getline(stream, line))
+        {
+            if (line.empty())
+                continue;
+
+            if (line.front() == L'[' && line.back() == L']')
+            {
+                values = &CreateKey(std::wstring_view{line}.substr(1, line.size() - 2));
+                continue;
+            }
+
+            if (!values)
+                return std::make_error_code(std::errc::illegal_byte_sequence);
+
+            RegistryValue value;
+            size_t position = 0;
+            if (line.front() == L'@')
+                position = 1;
+            else if (!Unquote(line, position, value.name))
+                return std::make_error_code(std::errc::illegal_byte_sequence);
+
+            if (position >= line.size() || line[position++] != L'=' || !Unquote(line, position, value.data) || position != line.size())
+                return std::make_error_code(std::errc::illegal_byte_sequence);
+
+            (*values)[FoldRegistryPath(value.name)] = std::move(value);
+        }
+        return {};
+    }
+
+private:
+    struct Key
+    {
+        std::wstring path;
+        std::map<std::wstring, RegistryValue> values; ///< By folded name
+    };
+
+    /** Create the key and its parents, like RegCreateKeyEx does */
+    std::map<std::wstring, RegistryValue>& CreateKey(std::wstring_view path)
+    {
+        // Keys are only deleted with their subkeys, so an existing key has all its parents
+        auto folded = FoldRegistryPath(path);
+        if (const auto key = m_keys.find(folded); key != m_keys.end())
+            return key->second.values;
+
+        for (auto separator = path.find(L'\\'); separator != std::wstring_view::npos; separator = path.find(L'\\', separator + 1))
+            m_keys.try_emplace(FoldRegistryPath(path.substr(0, separator)), Key{std::wstring{path.substr(0, separator)}, {}});
+
+        return m_keys.try_emplace(std::move(folded), Key{std::wstring{path}, {}}).first->second.values;
+    }
+
+    static std::wstring Quote(std::wstring_view text)
+    {
+        std::wstring quoted{L'"'};
+        for (const auto c : text)
+        {
+            if (c == L'"' || c == L'\\')
+                quoted += L'\\';
+            quoted += c;
+        }
+        quoted += L'"';
+        return quoted;
+    }
+
+    static bool Unquote(std::wstring_view line, size_t& position, std::wstring& text)
+    {
+        if (position >= line.size() || line[position++] != L'"')
+            return false;
+
+        for (; position < line.size(); ++position)
+        {
+            auto c = line[position];
+            if (c == L'"')
+            {
+                ++position;
+                return true;
+            }
+            if (c == L'\\' && ++position < line.size())
+                c = line[position];
+            text += c;
+        }
+        return false;
+    }
+
+    std::map<std::wstring, Key> m_keys; ///< By folded path
+    size_t m_writeCount = 0;
+    size_t m_deleteCount = 0;
+};
+
+/** MemoryRegistry that is loaded from a file when constructed, and saved to it by Flush */
+class FileRegistry final : public MemoryRegistry
+{
+public:
+    /** A missing file is an empty registry */
+    explicit FileRegistry(std::string path)
+        : m_path(std::move(path))
+    {
+        std::wifstream file{m_path};
+        if (file && Load(file))
+            throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "FileRegistry can not parse " + m_path);
+    }
+
+    std::error_code Flush() const
+    {
+        std::wofstream file{m_path, std::ios::trunc};
+        Save(file);
+        file.flush();
+        return file ? std::error_code{} : std::make_error_code(std::errc::io_error);
+    }
+
+private:
+    std::string m_path;
+};
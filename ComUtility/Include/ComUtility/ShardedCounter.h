@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/** Counter for frequent increments and decrements from many threads, that is rarely read.
+ *
+ * A single interlocked counter makes every core that updates it fight for the same cache
+ * line. Here each thread updates one of a fixed number of shards, each on its own cache
+ * line, and only Count visits all of them. Threads are assigned shards round robin, so
+ * threads share a shard only when there are more threads than shards.
+ *
+ * Each shard counts increments and decrements separately, and never goes down. Count reads
+ * all decrements before all increments. An object that was released during Count can then
+ * make the result too high, but never too low, so a count of zero means that the counter
+ * really was zero while Count was running. Count is what DllCanUnloadNow needs. */
+class ShardedCounter final
+{
+public:
+    static constexpr size_t ShardCount = 64;
+
+    void Increment() noexcept
+    {
+        m_shards[ShardOfThisThread()].increments.fetch_add(1);
+    }
+
+    void Decrement() noexcept
+    {
+        m_shards[ShardOfThisThread()].decrements.fetch_add(1);
+    }
+
+    /** Increments minus decrements, summed over all shards */
+    int64_t Count() const noexcept
+    {
+        uint64_t decrements = 0;
+        for (const auto& shard : m_shards)
+            decrements += shard.decrements.load();
+
+        uint64_t increments = 0;
+        for (const auto& shard : m_shards)
+            increments += shard.increments.load();
+
+        return static_cast<int64_t>(increments - decrements);
+    }
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> increments = 0;
+        std::atomic<uint64_t> decrements = 0;
+    };
+
+    /** Same for all counters, so that a thread touches one shard of each */
+    static size_t ShardOfThisThread() noexcept
+    {
+        static std::atomic<size_t> nextThread = 0;
+        static thread_local const size_t shard = nextThread.fetch_add(1, std::memory_order_relaxed) % ShardCount;
+        return shard;
+    }
+
+    Shard m_shards[ShardCount];
+};
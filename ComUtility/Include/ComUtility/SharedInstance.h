@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <ObjIdl.h>
+
+/** Handle to an object that any number of threads can use, created by ComFactory::CreateSharedInstance.
+ *
+ * The object is registered in the Global Interface Table (GIT), which marshals it table-strong,
+ * so that it can be unmarshaled again and again. Each thread resolves its own proxy on the first
+ * call to Get, and later calls on the same thread reuse that proxy until the thread makes its last
+ * CoUninitialize. Copies share the registration, which is revoked when the last copy is destroyed.
+ * Like any COM pointer, the last copy must be destroyed on a thread that is in COM. */
+class SharedInstance final
+{
+public:
+    SharedInstance() noexcept = default;
+
+    /** False for a default constructed handle */
+    explicit operator bool() const noexcept
+    {
+        return m_registration != nullptr;
+    }
+
+    /** Get the object on the calling thread, which must be in COM. Returns E_HANDLE for an empty handle. */
+    HRESULT Get(const IID& riid, void** ppv) const;
+
+    template <typename T>
+    HRESULT Get(T** ppv) const
+    {
+        return Get(__uuidof(T), reinterpret_cast<void**>(ppv));
+    }
+
+private:
+    friend class ComFactory;
+    struct Registration;
+
+    /** Take ownership of a GIT cookie. The cookie is revoked if the handle cannot be allocated. */
+    static HRESULT Adopt(IGlobalInterfaceTable* table, DWORD cookie, const IID& riid, SharedInstance& instance) noexcept;
+
+    std::shared_ptr<Registration> m_registration;
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature, size_t Capacity = 64>
+class SmallFunction;
+
+/** Move-only replacement for std::function with small buffer optimization.
+ *
+ * Callables that fit in Capacity bytes, and that can be moved without throwing, are
+ * stored inline. Larger callables fall back to the heap. Being move-only, it can hold
+ * callables that capture move-only state like promises and COM smart pointers. */
+template <typename R, typename... Args, size_t Capacity>
+class SmallFunction<R(Args...), Capacity>
+{
+    struct VTable
+    {
+        R (*invoke)(void* storage, Args&&... args);
+        void (*move)(void* destination, void* source) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template <typename F>
+    static constexpr bool IsInline = sizeof(F) <= Capacity &&
+                                     alignof(F) <= alignof(std::max_align_t) &&
+                                     std::is_nothrow_move_constructible_v<F>;
+
+    template <typename F>
+    static F& Get(void* storage) noexcept
+    {
+        if constexpr (IsInline<F>)
+            return *std::launder(static_cast<F*>(storage));
+        else
+            return **static_cast<F**>(storage);
+    }
+
+    template <typename F>
+    static constexpr VTable VTableFor{
+        [](void* storage, Args&&... args) -> R {
+            return Get<F>(storage)(std::forward<Args>(args)...);
+        },
+        [](void* destination, void* source) noexcept {
+            if constexpr (IsInline<F>)
+            {
+                new (destination) F(std::move(Get<F>(source)));
+                Get<F>(source).~F();
+            }
+            else
+            {
+                *static_cast<F**>(destination) = *static_cast<F**>(source);
+            }
+        },
+        [](void* storage) noexcept {
+            if constexpr (IsInline<F>)
+                Get<F>(storage).~F();
+            else
+                delete *static_cast<F**>(storage);
+        },
+    };
+
+public:
+    SmallFunction() noexcept = default;
+
+    template <typename Callable,
+              typename F = std::decay_t<Callable>,
+              typename = std::enable_if_t<!std::is_same_v<F, SmallFunction> && std::is_invocable_r_v<R, F&, Args...>>>
+    SmallFunction(Callable&& callable)
+    {
+        if constexpr (IsInline<F>)
+            new (&m_storage) F(std::forward<Callable>(callable));
+        else
+            *reinterpret_cast<F**>(&m_storage) = new F(std::forward<Callable>(callable));
+
+        m_vtable = &VTableFor<F>;
+    }
+
+    SmallFunction(SmallFunction&& other) noexcept
+    {
+        MoveFrom(other);
+    }
+
+    SmallFunction& operator=(SmallFunction&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    SmallFunction(const SmallFunction&) = delete;
+    SmallFunction& operator=(const SmallFunction&) = delete;
+
+    ~SmallFunction()
+    {
+        Reset();
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return m_vtable != nullptr;
+    }
+
+    R operator()(Args... args)
+    {
+        return m_vtable->invoke(&m_storage, std::forward<Args>(args)...);
+    }
+
+    /** True if a callable of type F is stored without heap allocation */
+    template <typename F>
+    static constexpr bool StoresInline() noexcept
+    {
+        return IsInline<std::decay_t<F>>;
+    }
+
+private:
+    void MoveFrom(SmallFunction& other) noexcept
+    {
+        if (other.m_vtable)
+        {
+            other.m_vtable->move(&m_storage, &other.m_storage);
+            m_vtable = std::exchange(other.m_vtable, nullptr);
+        }
+    }
+
+    void Reset() noexcept
+    {
+        if (m_vtable)
+            std::exchange(m_vtable, nullptr)->destroy(&m_storage);
+    }
+
+    alignas(std::max_align_t) unsigned char m_storage[Capacity];
+    const VTable* m_vtable = nullptr;
+};
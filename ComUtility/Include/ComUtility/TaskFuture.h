@@ -0,0 +1,294 @@
+#pragma once
+#include "ObjectPool.h"
+#include "SmallFunction.h"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+template <typename T>
+class TaskPromise;
+
+/** State shared between a TaskPromise and its TaskFuture. The state is allocated
+ * from an ObjectPool, so that a promise/future pair does not touch the heap in steady state. */
+template <typename T>
+class TaskState final
+{
+    struct Empty
+    {
+    };
+
+    /** Futures of void only signal completion */
+    using Value = std::conditional_t<std::is_void_v<T>, Empty, T>;
+
+public:
+    template <typename... Args>
+    void SetValue(Args&&... value)
+    {
+        std::unique_lock lock(m_mutex);
+        m_value.emplace(std::forward<Args>(value)...);
+        MakeReady(lock);
+    }
+
+    void SetException(std::exception_ptr exception)
+    {
+        std::unique_lock lock(m_mutex);
+        m_exception = std::move(exception);
+        MakeReady(lock);
+    }
+
+    /** Call callback(context) when the state becomes ready. Returns false without
+     * registering the callback if the state is ready already. */
+    bool SetContinuation(void (*callback)(void*), void* context)
+    {
+        std::lock_guard guard(m_mutex);
+        if (m_ready)
+            return false;
+
+        m_continuation = callback;
+        m_continuationContext = context;
+        return true;
+    }
+
+    bool IsReady()
+    {
+        std::lock_guard guard(m_mutex);
+        return m_ready;
+    }
+
+    void Wait()
+    {
+        std::unique_lock lock(m_mutex);
+        m_condition.wait(lock, [this] { return m_ready; });
+    }
+
+    T Get()
+    {
+        Wait();
+        if (m_exception)
+            std::rethrow_exception(m_exception);
+        if constexpr (!std::is_void_v<T>)
+            return std::move(*m_value);
+    }
+
+    void AddRef() noexcept
+    {
+        m_references.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Release() noexcept
+    {
+        if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            ObjectPool<TaskState>::Delete(this);
+    }
+
+private:
+    void MakeReady(std::unique_lock<std::mutex>& lock)
+    {
+        m_ready = true;
+        m_condition.notify_all();
+
+        // Run the continuation outside the lock, since it may resume a coroutine that reads the result
+        const auto continuation = std::exchange(m_continuation, nullptr);
+        lock.unlock();
+        if (continuation)
+            continuation(m_continuationContext);
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_ready = false;
+    std::optional<Value> m_value;
+    std::exception_ptr m_exception;
+    void (*m_continuation)(void*) = nullptr;
+    void* m_continuationContext = nullptr;
+    std::atomic<int> m_references{1};
+};
+
+/** Pooled replacement for std::future. The result can only be retrieved once. */
+template <typename T>
+class TaskFuture final
+{
+public:
+    TaskFuture() noexcept = default;
+
+    TaskFuture(TaskFuture&& other) noexcept : m_state(std::exchange(other.m_state, nullptr)) {}
+
+    TaskFuture& operator=(TaskFuture&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            m_state = std::exchange(other.m_state, nullptr);
+        }
+        return *this;
+    }
+
+    TaskFuture(const TaskFuture&) = delete;
+    TaskFuture& operator=(const TaskFuture&) = delete;
+
+    ~TaskFuture()
+    {
+        Reset();
+    }
+
+    bool valid() const noexcept
+    {
+        return m_state != nullptr;
+    }
+
+    bool is_ready() const
+    {
+        return m_state->IsReady();
+    }
+
+    void wait() const
+    {
+        m_state->Wait();
+    }
+
+    /** Call callback(context) on the thread that completes the promise. Returns false without
+     * registering the callback if the result is ready already. At most one continuation
+     * can be registered. */
+    bool set_continuation(void (*callback)(void*), void* context)
+    {
+        return m_state->SetContinuation(callback, context);
+    }
+
+    /** Wait for the result and return it, or rethrow the exception that was stored */
+    T get()
+    {
+        struct Releaser
+        {
+            TaskState<T>* state;
+            ~Releaser() { state->Release(); }
+        } releaser{std::exchange(m_state, nullptr)};
+
+        return releaser.state->Get();
+    }
+
+private:
+    friend class TaskPromise<T>;
+    explicit TaskFuture(TaskState<T>* state) noexcept : m_state(state) {}
+
+    void Reset() noexcept
+    {
+        if (m_state)
+            std::exchange(m_state, nullptr)->Release();
+    }
+
+    TaskState<T>* m_state = nullptr;
+};
+
+/** Pooled replacement for std::promise */
+template <typename T>
+class TaskPromise final
+{
+public:
+    TaskPromise() : m_state(ObjectPool<TaskState<T>>::New()) {}
+
+    TaskPromise(TaskPromise&& other) noexcept : m_state(std::exchange(other.m_state, nullptr)) {}
+
+    TaskPromise& operator=(TaskPromise&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Abandon();
+            m_state = std::exchange(other.m_state, nullptr);
+        }
+        return *this;
+    }
+
+    TaskPromise(const TaskPromise&) = delete;
+    TaskPromise& operator=(const TaskPromise&) = delete;
+
+    /** Like std::promise, an unsatisfied promise stores a broken_promise error */
+    ~TaskPromise()
+    {
+        Abandon();
+    }
+
+    /** Can only be called once */
+    TaskFuture<T> get_future()
+    {
+        m_state->AddRef();
+        return TaskFuture<T>{m_state};
+    }
+
+    /** Store the value, which is omitted for TaskPromise<void> */
+    template <typename... Value>
+    void set_value(Value&&... value)
+    {
+        const auto state = std::exchange(m_state, nullptr);
+        state->SetValue(std::forward<Value>(value)...);
+        state->Release();
+    }
+
+    void set_exception(std::exception_ptr exception)
+    {
+        const auto state = std::exchange(m_state, nullptr);
+        state->SetException(std::move(exception));
+        state->Release();
+    }
+
+private:
+    void Abandon() noexcept
+    {
+        if (m_state)
+            set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+    }
+
+    TaskState<T>* m_state;
+};
+
+/** Pooled replacement for std::packaged_task */
+template <typename T>
+class PackagedTask final
+{
+public:
+    using Callable = SmallFunction<T()>;
+
+    explicit PackagedTask(Callable callable) : m_callable(std::move(callable)) {}
+
+    TaskFuture<T> get_future()
+    {
+        return m_promise.get_future();
+    }
+
+    /** Run the callable, and store its result or exception in the future */
+    void operator()()
+    {
+        try
+        {
+            if constexpr (std::is_void_v<T>)
+            {
+                m_callable();
+                m_promise.set_value();
+            }
+            else
+            {
+                m_promise.set_value(m_callable());
+            }
+        }
+        catch (...)
+        {
+            m_promise.set_exception(std::current_exception());
+        }
+    }
+
+    /** Complete the future with a value instead of running the callable. Used for tasks that
+     * are dropped before they get to run. */
+    template <typename... Value>
+    void skip(Value&&... value)
+    {
+        m_promise.set_value(std::forward<Value>(value)...);
+    }
+
+private:
+    Callable m_callable;
+    TaskPromise<T> m_promise;
+};
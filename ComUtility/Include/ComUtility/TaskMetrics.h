@@ -0,0 +1,164 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/** Histogram of durations with power of two buckets. Bucket i counts durations of less
+ * than 2^i nanoseconds that did not fit in bucket i-1, and the last bucket counts
+ * everything longer. Recording is a couple of relaxed atomic increments, so it is cheap
+ * enough to stay enabled in production. */
+class LatencyHistogram final
+{
+public:
+    static constexpr size_t BucketCount = 40; ///< The last bucket starts at about 4.6 minutes
+
+    /** Copy of a histogram that can be inspected and exported */
+    struct Snapshot
+    {
+        std::array<uint64_t, BucketCount> buckets{};
+        uint64_t count = 0;
+        uint64_t totalNanoseconds = 0;
+
+        /** Exclusive upper bound of a bucket */
+        static constexpr std::chrono::nanoseconds UpperBound(size_t bucket) noexcept
+        {
+            return std::chrono::nanoseconds{bucket + 1 < BucketCount ? int64_t{1} << bucket : INT64_MAX};
+        }
+
+        std::chrono::nanoseconds Mean() const noexcept
+        {
+            return std::chrono::nanoseconds{count == 0 ? 0 : static_cast<int64_t>(totalNanoseconds / count)};
+        }
+
+        /** Upper bound of the bucket that contains the given percentile, in the range [0, 100].
+         * The result is at most a factor two above the exact percentile. */
+        std::chrono::nanoseconds Percentile(double percentile) const noexcept
+        {
+            if (count == 0)
+                return std::chrono::nanoseconds{0};
+
+            const auto rank = static_cast<uint64_t>(static_cast<double>(count) * percentile / 100.0);
+            uint64_t seen = 0;
+            size_t bucket = 0;
+            for (; bucket + 1 < BucketCount; ++bucket)
+            {
+                seen += buckets[bucket];
+                if (seen > rank || seen == count)
+                    break;
+            }
+            return UpperBound(bucket);
+        }
+
+        Snapshot& operator+=(const Snapshot& other) noexcept
+        {
+            for (size_t bucket = 0; bucket < BucketCount; ++bucket)
+                buckets[bucket] += other.buckets[bucket];
+            count += other.count;
+            totalNanoseconds += other.totalNanoseconds;
+            return *this;
+        }
+    };
+
+    void Record(std::chrono::nanoseconds duration) noexcept
+    {
+        const auto nanoseconds = static_cast<uint64_t>(duration.count() > 0 ? duration.count() : 0);
+        const auto bucket = std::bit_width(nanoseconds);
+        m_buckets[bucket < BucketCount ? bucket : BucketCount - 1].fetch_add(1, std::memory_order_relaxed);
+        m_totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    }
+
+    /** The snapshot is not atomic as a whole, but each bucket is read atomically */
+    Snapshot GetSnapshot() const noexcept
+    {
+        Snapshot snapshot;
+        for (size_t bucket = 0; bucket < BucketCount; ++bucket)
+        {
+            snapshot.buckets[bucket] = m_buckets[bucket].load(std::memory_order_relaxed);
+            snapshot.count += snapshot.buckets[bucket];
+        }
+        snapshot.totalNanoseconds = m_totalNanoseconds.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BucketCount> m_buckets{};
+    std::atomic<uint64_t> m_totalNanoseconds = 0;
+};
+
+/** Counters and latency histograms for tasks that go through a queue to a worker thread */
+class TaskMetrics final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Snapshot
+    {
+        uint64_t submitted = 0;              ///< Tasks accepted by the queue
+        uint64_t completed = 0;              ///< Tasks that have run
+        uint64_t dropped = 0;                ///< Tasks that were cancelled or expired before they could run
+        size_t queueDepth = 0;               ///< Tasks waiting to be run when the snapshot was taken
+        LatencyHistogram::Snapshot queueWait; ///< Time from submit until the task started
+        LatencyHistogram::Snapshot runTime;   ///< Time the task ran
+
+        Snapshot& operator+=(const Snapshot& other) noexcept
+        {
+            submitted += other.submitted;
+            completed += other.completed;
+            dropped += other.dropped;
+            queueDepth += other.queueDepth;
+            queueWait += other.queueWait;
+            runTime += other.runTime;
+            return *this;
+        }
+    };
+
+    /** Called by producers before a task is queued, so that a snapshot never shows more
+     * completed than submitted tasks */
+    void RecordSubmitted() noexcept
+    {
+        m_submitted.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /** Called by producers when a task that was recorded as submitted could not be queued */
+    void RevertSubmitted() noexcept
+    {
+        m_submitted.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /** Called by the worker thread when a task has run */
+    void RecordCompleted(Clock::time_point queued, Clock::time_point started, Clock::time_point finished) noexcept
+    {
+        m_queueWait.Record(started - queued);
+        m_runTime.Record(finished - started);
+        m_completed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /** Called by the worker thread when a task is dropped instead of run */
+    void RecordDropped() noexcept
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Snapshot GetSnapshot(size_t queueDepth) const noexcept
+    {
+        Snapshot snapshot;
+        snapshot.submitted = m_submitted.load(std::memory_order_relaxed);
+        snapshot.completed = m_completed.load(std::memory_order_relaxed);
+        snapshot.dropped = m_dropped.load(std::memory_order_relaxed);
+        snapshot.queueDepth = queueDepth;
+        snapshot.queueWait = m_queueWait.GetSnapshot();
+        snapshot.runTime = m_runTime.GetSnapshot();
+        return snapshot;
+    }
+
+private:
+    // Producers and the worker thread write to separate cache lines
+    alignas(64) std::atomic<uint64_t> m_submitted = 0;
+    alignas(64) std::atomic<uint64_t> m_completed = 0;
+    std::atomic<uint64_t> m_dropped = 0;
+    LatencyHistogram m_queueWait;
+    LatencyHistogram m_runTime;
+};
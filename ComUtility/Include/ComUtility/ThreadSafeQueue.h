@@ -27,6 +27,12 @@ public:
         m_q.pop_back();
     }
 
+    bool empty()
+    {
+        std::lock_guard guard(m_mutex);
+        return m_q.empty();
+    }
+
 private:
     std::mutex m_mutex;
     std::deque<T> m_q;
@@ -77,6 +77,10 @@ private:
 /** Raise system error given a windows specific error code, for example from GetLastError() */
 void RaiseSystemError(DWORD error, const char* message);
 
+/** Write a failure that can not be returned to anyone to the debugger output, for example
+ * WriteToDebugger(L"ComApartment: Posted task", result) */
+void WriteToDebugger(const wchar_t* what, HRESULT result) noexcept;
+
 // Auto-link
 #ifndef COM_UTILITY_BUILD
 #pragma comment(lib, "ComUtility.lib")
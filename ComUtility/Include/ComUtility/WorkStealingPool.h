@@ -0,0 +1,277 @@
+#pragma once
+#include "Executor.h"
+#include "SmallFunction.h"
+#include "TaskFuture.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/** Default worker state for a WorkStealingPool that needs no per thread initialization */
+struct NoWorkerState
+{
+};
+
+/** Thread pool where each worker has its own task deque.
+ *
+ * Tasks submitted from a worker thread go to the back of that worker's deque, and the
+ * worker takes its newest task first, which keeps related work hot in its cache. Tasks
+ * submitted from other threads are spread over the workers. A worker that runs out of
+ * tasks steals the oldest task from another worker before it goes to sleep.
+ *
+ * Each worker constructs a WorkerState on its own thread before it runs any tasks, and
+ * destroys it when the pool is destroyed. With ComRuntime as the worker state, all
+ * workers join the multithreaded apartment once, instead of once per task. */
+template <typename WorkerState = NoWorkerState>
+class WorkStealingPool : public Executor
+{
+public:
+    /** Type erased task. The capacity fits a PackagedTask with a small capture, so that
+     * Submit does not allocate for typical callables. */
+    using Task = SmallFunction<void(), 128>;
+
+    /** Start the workers, and forward stateArgs to the WorkerState constructor on each worker
+     * thread. If a worker state fails to initialize, the pool is shut down and the exception
+     * is rethrown. */
+    template <typename... StateArgs>
+    explicit WorkStealingPool(size_t workerCount, StateArgs... stateArgs)
+        : m_workers(std::max<size_t>(workerCount, 1))
+    {
+        m_threads.reserve(m_workers.size());
+        try
+        {
+            for (size_t index = 0; index < m_workers.size(); ++index)
+            {
+                m_threads.emplace_back([this, index, stateArgs...] {
+                    std::optional<WorkerState> state;
+                    if (!InitializeWorker([&] { state.emplace(stateArgs...); }))
+                        return;
+                    RunWorker(index);
+                });
+            }
+            WaitForWorkers();
+        }
+        catch (...)
+        {
+            Shutdown();
+            throw;
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /** Runs the tasks that are already submitted, and joins the worker threads */
+    ~WorkStealingPool() override
+    {
+        Shutdown();
+    }
+
+    /** Run a callable on one of the workers. The returned future holds the result of the
+     * callable, or the exception it threw. */
+    template <typename Callable, typename R = std::invoke_result_t<std::decay_t<Callable>&>>
+    TaskFuture<R> Submit(Callable&& callable)
+    {
+        PackagedTask<R> task{std::forward<Callable>(callable)};
+        auto future = task.get_future();
+        Enqueue(std::move(task));
+        return future;
+    }
+
+    /** Run a callable on one of the workers without a future, for work that reports its own
+     * results. The callable must not throw, since there is nobody to catch the exception. */
+    template <typename Callable>
+    void Post(Callable&& callable)
+    {
+        Enqueue(Task{std::forward<Callable>(callable)});
+    }
+
+    /** Queued work is never dropped, since the pool runs it before it is destroyed */
+    void Execute(void (*function)(void*), void (*)(void*), void* data) override
+    {
+        Post([function, data] { function(data); });
+    }
+
+    size_t WorkerCount() const noexcept
+    {
+        return m_workers.size();
+    }
+
+private:
+    struct alignas(64) Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;   ///< The owner works at the back, thieves take from the front
+    };
+
+    /** Identifies the pool and worker that runs on the current thread */
+    struct CurrentWorker
+    {
+        const WorkStealingPool* pool = nullptr;
+        size_t index = 0;
+    };
+
+    static CurrentWorker& ThisWorker() noexcept
+    {
+        static thread_local CurrentWorker current;
+        return current;
+    }
+
+    void Enqueue(Task task)
+    {
+        const auto& current = ThisWorker();
+        const auto index = current.pool == this
+                               ? current.index
+                               : m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+
+        // Count the task before it becomes visible, so that the count never underflows
+        m_queuedCount.fetch_add(1, std::memory_order_seq_cst);
+        try
+        {
+            auto& worker = m_workers[index];
+            std::lock_guard guard(worker.mutex);
+            worker.tasks.push_back(std::move(task));
+        }
+        catch (...)
+        {
+            m_queuedCount.fetch_sub(1, std::memory_order_relaxed);
+            throw;
+        }
+
+        // Pairs with the increment of m_sleepingCount in Sleep, so that either we see
+        // the sleeper, or the sleeper sees the task
+        if (m_sleepingCount.load(std::memory_order_seq_cst) != 0)
+        {
+            std::lock_guard guard(m_sleepMutex);
+            m_wakeup.notify_one();
+        }
+    }
+
+    template <typename Initialize>
+    bool InitializeWorker(Initialize&& initialize)
+    {
+        std::exception_ptr error;
+        try
+        {
+            initialize();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        std::lock_guard guard(m_sleepMutex);
+        if (error && !m_initError)
+            m_initError = error;
+        ++m_initializedCount;
+        m_wakeup.notify_all();
+        return !error;
+    }
+
+    /** Wait until all workers are initialized, and rethrow the first initialization error */
+    void WaitForWorkers()
+    {
+        std::unique_lock lock(m_sleepMutex);
+        m_wakeup.wait(lock, [this] { return m_initializedCount == m_workers.size(); });
+        if (m_initError)
+            std::rethrow_exception(m_initError);
+    }
+
+    void Shutdown() noexcept
+    {
+        {
+            std::lock_guard guard(m_sleepMutex);
+            m_stopping = true;
+        }
+        m_wakeup.notify_all();
+
+        for (auto& thread : m_threads)
+            thread.join();
+        m_threads.clear();
+    }
+
+    void RunWorker(size_t index)
+    {
+        const CurrentScope executor{this};
+        ThisWorker() = CurrentWorker{this, index};
+        for (;;)
+        {
+            if (auto task = TakeOwn(index))
+            {
+                m_queuedCount.fetch_sub(1, std::memory_order_relaxed);
+                (*task)();
+            }
+            else if (auto stolen = Steal(index))
+            {
+                m_queuedCount.fetch_sub(1, std::memory_order_relaxed);
+                (*stolen)();
+            }
+            else if (!Sleep())
+            {
+                break;
+            }
+        }
+        ThisWorker() = CurrentWorker{};
+    }
+
+    std::optional<Task> TakeOwn(size_t index)
+    {
+        auto& worker = m_workers[index];
+        std::lock_guard guard(worker.mutex);
+        if (worker.tasks.empty())
+            return std::nullopt;
+
+        std::optional<Task> task{std::move(worker.tasks.back())};
+        worker.tasks.pop_back();
+        return task;
+    }
+
+    std::optional<Task> Steal(size_t thief)
+    {
+        for (size_t offset = 1; offset < m_workers.size(); ++offset)
+        {
+            auto& victim = m_workers[(thief + offset) % m_workers.size()];
+            std::lock_guard guard(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                std::optional<Task> task{std::move(victim.tasks.front())};
+                victim.tasks.pop_front();
+                return task;
+            }
+        }
+        return std::nullopt;
+    }
+
+    /** Wait for new tasks. Returns false when the pool is stopping and all tasks have run. */
+    bool Sleep()
+    {
+        std::unique_lock lock(m_sleepMutex);
+        m_sleepingCount.fetch_add(1, std::memory_order_seq_cst);
+        m_wakeup.wait(lock, [this] {
+            return m_stopping || m_queuedCount.load(std::memory_order_seq_cst) != 0;
+        });
+        m_sleepingCount.fetch_sub(1, std::memory_order_relaxed);
+        return !m_stopping || m_queuedCount.load(std::memory_order_seq_cst) != 0;
+    }
+
+    std::vector<Worker> m_workers;
+    std::vector<std::thread> m_threads;
+    std::atomic<size_t> m_nextWorker = 0;       ///< Spreads tasks submitted from other threads over the workers
+    std::atomic<size_t> m_queuedCount = 0;      ///< Number of tasks in all deques
+    std::atomic<size_t> m_sleepingCount = 0;    ///< Number of workers waiting for tasks
+
+    std::mutex m_sleepMutex;                    ///< Protects the members below, and sleeping workers
+    std::condition_variable m_wakeup;
+    bool m_stopping = false;
+    size_t m_initializedCount = 0;
+    std::exception_ptr m_initError;
+};
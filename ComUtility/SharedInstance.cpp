@@ -0,0 +1,74 @@
+#include "pch.h"
+#include "Include/ComUtility/SharedInstance.h"
+#include "Include/ComUtility/CachedAgilePtr.h"
+#include <new>
+#include <wrl.h>
+
+using Microsoft::WRL::ComPtr;
+
+struct SharedInstance::Registration final
+{
+    Registration(IGlobalInterfaceTable* globalTable, DWORD globalCookie, const IID& riid)
+        : id(Detail::AgileResolveCache::NewId())
+        , table(globalTable)
+        , cookie(globalCookie)
+        , iid(riid)
+    {
+    }
+
+    Registration(const Registration&) = delete;
+    Registration& operator=(const Registration&) = delete;
+
+    ~Registration()
+    {
+        table->RevokeInterfaceFromGlobal(cookie);
+    }
+
+    uint64_t id; ///< Key in the thread caches, shared with CachedAgilePtr
+    ComPtr<IGlobalInterfaceTable> table;
+    DWORD cookie;
+    IID iid; ///< The interface that was registered
+};
+
+HRESULT SharedInstance::Adopt(IGlobalInterfaceTable* table, DWORD cookie, const IID& riid, SharedInstance& instance) noexcept
+{
+    try
+    {
+        instance.m_registration = std::make_shared<Registration>(table, cookie, riid);
+        return S_OK;
+    }
+    catch (const std::bad_alloc&)
+    {
+        table->RevokeInterfaceFromGlobal(cookie);
+        return E_OUTOFMEMORY;
+    }
+}
+
+HRESULT SharedInstance::Get(const IID& riid, void** ppv) const
+{
+    if (!ppv)
+        return E_POINTER;
+    *ppv = nullptr;
+
+    if (!m_registration)
+        return E_HANDLE;
+
+    const auto& registration = *m_registration;
+    if (const auto cached = Detail::AgileResolveCache::Find(registration.id))
+        return cached->QueryInterface(riid, ppv);
+
+    ComPtr<IUnknown> resolved;
+    const auto result = registration.table->GetInterfaceFromGlobal(registration.cookie, registration.iid, reinterpret_cast<void**>(resolved.GetAddressOf()));
+    if (result != S_OK)
+        return result;
+
+    try
+    {
+        Detail::AgileResolveCache::Insert(registration.id, m_registration, resolved.Get());
+    }
+    catch (const std::bad_alloc&)
+    {
+        // Not cached, but the proxy can still be used
+    }
+    return resolved->QueryInterface(riid, ppv);
+}
@@ -5,6 +5,7 @@
 #include "framework.h"
 #include "Include/ComUtility/Utility.h"
 
+#include <cstdio>
 #include <system_error>
 
 void RaiseSystemError(DWORD error, const char* message)
@@ -12,3 +13,10 @@ void RaiseSystemError(DWORD error, const char* message)
     const std::error_code errorCode{static_cast<int>(error), std::system_category()};
     throw std::system_error(errorCode, message);
 }
+
+void WriteToDebugger(const wchar_t* what, HRESULT result) noexcept
+{
+    wchar_t message[128]{};
+    _snwprintf_s(message, _TRUNCATE, L"%s failed with 0x%08X\n", what, static_cast<unsigned int>(result));
+    OutputDebugStringW(message);
+}
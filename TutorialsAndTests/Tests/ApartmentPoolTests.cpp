@@ -0,0 +1,143 @@
+#include <ComUtility/ApartmentPool.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <set>
+#include <stdexcept>
+
+namespace
+{
+    /** Apartment with a queue depth that is controlled by the test */
+    struct FakeApartment
+    {
+        size_t QueueDepth() const
+        {
+            return depth;
+        }
+
+        size_t depth = 0;
+    };
+
+    ApartmentPool<FakeApartment> MakePool(const ApartmentPoolOptions& options, int* created = nullptr)
+    {
+        return ApartmentPool<FakeApartment>{options, [created] {
+            if (created)
+                ++*created;
+            return std::make_unique<FakeApartment>();
+        }};
+    }
+}
+
+TEST(ApartmentPoolTests,
+    RequireThat_Constructor_CreatesMinApartments)
+{
+    int created = 0;
+    auto pool = MakePool({2, 4}, &created);
+
+    EXPECT_EQ(created, 2);
+    EXPECT_EQ(pool.Size(), 2u);
+    EXPECT_EQ(pool.ActiveCount(), 2u);
+}
+
+TEST(ApartmentPoolTests,
+    RequireThat_Constructor_Throws_WhenBoundsAreInvalid)
+{
+    EXPECT_THROW(MakePool({0, 1}), std::invalid_argument);
+    EXPECT_THROW(MakePool({3, 2}), std::invalid_argument);
+}
+
+TEST(ApartmentPoolTests,
+    RequireThat_RoundRobin_VisitsAllApartments)
+{
+    auto pool = MakePool({3, 3, Placement::RoundRobin});
+
+    auto& first = pool.Select();
+    std::set<FakeApartment*> selected{&first};
+    for (int i = 0; i < 2; ++i)
+        selected.insert(&pool.Select());
+
+    EXPECT_EQ(selected.size(), 3u);
+    EXPECT_EQ(&pool.Select(), &first);
+}
+
+TEST(ApartmentPoolTests,
+    RequireThat_LeastQueueDepth_SelectsLeastLoadedApartment)
+{
+    auto pool = MakePool({3, 3, Placement::LeastQueueDepth});
+
+    size_t depth = 5;
+    FakeApartment* idlest = nullptr;
+    pool.ForEach([&](FakeApartment& apartment) {
+        apartment.depth = depth--;
+        idlest = &apartment;
+    });
+
+    EXPECT_EQ(&pool.Select(), idlest);
+
+    idlest->depth = 10;
+    EXPECT_NE(&pool.Select(), idlest);
+}
+
+TEST(ApartmentPoolTests,
+    RequireThat_AffinityKey_SelectsSameApartmentForSameKey)
+{
+    auto pool = MakePool({4, 4, Placement::AffinityKey});
+
+    std::set<FakeApartment*> selected;
+    for (size_t key = 0; key < 64; ++key)
+    {
+        EXPECT_EQ(&pool.Select(key), &pool.Select(key));
+        selected.insert(&pool.Select(key));
+    }
+
+    EXPECT_EQ(selected.size(), 4u);
+}
+
+TEST(ApartmentPoolTests,
+    RequireThat_Select_GrowsPool_WhenQueueDepthExceedsThreshold)
+{
+    auto options = ApartmentPoolOptions{1, 3, Placement::LeastQueueDepth};
+    options.growQueueDepth = 2;
+    auto pool = MakePool(options);
+
+    auto& first = pool.Select();
+    first.depth = 2;
+    EXPECT_EQ(&pool.Select(), &first);
+    EXPECT_EQ(pool.Size(), 1u);
+
+    first.depth = 3;
+    auto& second = pool.Select();
+    EXPECT_NE(&second, &first);
+    EXPECT_EQ(pool.Size(), 2u);
+
+    second.depth = 3;
+    pool.Select().depth = 3;
+    pool.Select();
+    EXPECT_EQ(pool.Size(), 3u) << "Pool must not grow beyond max apartments";
+}
+
+TEST(ApartmentPoolTests,
+    RequireThat_Select_ShrinksPool_AfterIdlePlacements_AndReusesApartmentsWhenGrowing)
+{
+    auto options = ApartmentPoolOptions{1, 2, Placement::RoundRobin};
+    options.growQueueDepth = 1;
+    options.shrinkAfterIdlePlacements = 4;
+    int created = 0;
+    auto pool = MakePool(options, &created);
+
+    auto& first = pool.Select();
+    first.depth = 2;
+    auto& second = pool.Select();
+    EXPECT_EQ(pool.ActiveCount(), 2u);
+
+    first.depth = 0;
+    for (int i = 0; i < 4; ++i)
+        pool.Select();
+
+    EXPECT_EQ(pool.ActiveCount(), 1u);
+    EXPECT_EQ(pool.Size(), 2u) << "Deactivated apartments must be kept alive";
+
+    first.depth = 2;
+    EXPECT_EQ(&pool.Select(), &second);
+    EXPECT_EQ(pool.ActiveCount(), 2u);
+    EXPECT_EQ(created, 2);
+}
@@ -6,6 +6,7 @@
 #include <winrt/base.h>
 #include <wrl.h>
 #include "Mocks/IPostmanMock.h"
+#include <array>
 
 using namespace testing;
 using Microsoft::WRL::ComPtr;
@@ -31,3 +32,60 @@ TEST(AtlFreServerTests, RequireThat_Bite_CausesDogToBitePostman)
 
     HR(guardDog->Bite(postman.Get()));
 }
+
+// Test that demonstrates batch creation through a custom interface on the class object
+TEST(AtlFreServerTests, RequireThat_CreateDogs_CreatesAllDogs_WhenCalledOnClassObject)
+{
+    ComPtr<IPuppyFarm> farm;
+    HR(CoGetClassObject(__uuidof(GuardDog), CLSCTX_INPROC_SERVER, nullptr, __uuidof(IPuppyFarm), &farm));
+
+    std::array<IDog*, 3> dogs{};
+    HR(farm->CreateDogs(static_cast<ULONG>(dogs.size()), dogs.data()));
+
+    for (const auto dog : dogs)
+    {
+        ComPtr<IDog> owner;
+        owner.Attach(dog);
+        EXPECT_EQ(S_OK, owner->Sit());
+    }
+}
+
+// The surrogate only exposes IClassFactory of class objects, so out of process the farm is
+// created as an object. Each batch is then a single round trip to dllhost.exe.
+TEST(AtlFreServerTests, RequireThat_CreateDogs_CreatesAllDogs_WhenFarmIsInSeparateProcess)
+{
+    ComPtr<IPuppyFarm> farm;
+    HR(CoCreateInstance(__uuidof(PuppyFarm), nullptr, CLSCTX_LOCAL_SERVER, __uuidof(IPuppyFarm), &farm));
+
+    std::array<IDog*, 3> dogs{};
+    HR(farm->CreateDogs(static_cast<ULONG>(dogs.size()), dogs.data()));
+
+    for (const auto dog : dogs)
+    {
+        ComPtr<IDog> owner;
+        owner.Attach(dog);
+        EXPECT_EQ(S_OK, owner->Sit());
+    }
+}
+
+// Test that demonstrates batched calls, where each victim gets its own result
+TEST(AtlFreServerTests, RequireThat_BiteAll_BitesAllPostmen_AndReturnsResultPerPostman)
+{
+    const auto first = wrl::Make<IPostmanMock>();
+    const auto second = wrl::Make<IPostmanMock>();
+    const auto third = wrl::Make<IPostmanMock>();
+    EXPECT_CALL(*first.Get(), OnBitten()).WillOnce(Return(S_OK));
+    EXPECT_CALL(*second.Get(), OnBitten()).WillOnce(Return(E_ACCESSDENIED));
+    EXPECT_CALL(*third.Get(), OnBitten()).WillOnce(Return(S_OK));
+
+    ComPtr<IDog2> guardDog;
+    HR(CoCreateInstance(__uuidof(GuardDog), nullptr, CLSCTX_INPROC_SERVER, __uuidof(IDog2), &guardDog));
+
+    std::array<IPostman*, 3> victims{first.Get(), second.Get(), third.Get()};
+    std::array<HRESULT, 3> results{};
+    EXPECT_EQ(S_FALSE, guardDog->BiteAll(static_cast<ULONG>(victims.size()), victims.data(), results.data()));
+
+    EXPECT_EQ(S_OK, results[0]);
+    EXPECT_EQ(E_ACCESSDENIED, results[1]);
+    EXPECT_EQ(S_OK, results[2]);
+}
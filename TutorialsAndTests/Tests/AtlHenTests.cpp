@@ -9,6 +9,7 @@
 #include <winrt/base.h>
 #include <wrl.h>
 #include <future>
+#include <olectl.h>
 #include "Mocks/IHenMock.h"
 #include "ComUtility/Utility.h"
 
@@ -152,8 +153,11 @@ TEST(AtlHenTests, ObserveThat_CluckAsync_Fails_WhenCalledFromWorkerThread)
 // Test that demonstrates use of the free threaded marshaler which allows calling an object from any thread.
 TEST(FreeThreadedHenTests, RequireThat_Cluck_IsCalledOnAsyncCluckObserver_WhenCalledFromWorkerThread)
 {
+    // CluckAsync returns before the observer is called, so the test waits for the callback
+    std::promise<void> clucked;
     auto observer = winrt::make_self<FreeThreadedCluckObserver>();
-    EXPECT_CALL(*observer, OnCluck()).WillOnce(Invoke([] {
+    EXPECT_CALL(*observer, OnCluck()).WillOnce(Invoke([&clucked] {
+        clucked.set_value();
         return S_OK;
     }));
 
@@ -169,4 +173,45 @@ TEST(FreeThreadedHenTests, RequireThat_Cluck_IsCalledOnAsyncCluckObserver_WhenCa
     });
 
     EXPECT_EQ(result.get(), S_OK);
-}
\ No newline at end of file
+    EXPECT_EQ(clucked.get_future().wait_for(std::chrono::seconds(10)), std::future_status::ready);
+}
+
+// Test that demonstrates how one cluck notifies every subscribed observer
+TEST(SubscriptionHenTests, RequireThat_Cluck_IsCalledOnAllSubscribedObservers_WhenHenClucks)
+{
+    auto result = std::async(std::launch::async, [] {
+        ComRuntime comRuntime{Apartment::MultiThreaded};
+
+        CComPtr<ISubscribableHen> hen;
+        HR(CoCreateInstance(CLSID_SubscriptionHen, nullptr, CLSCTX_INPROC_SERVER, IID_ISubscribableHen, reinterpret_cast<void**>(&hen)));
+
+        // Cluck returns before the observers are called, so the test waits for the callbacks
+        std::promise<void> first;
+        std::promise<void> second;
+        auto firstObserver = winrt::make_self<FreeThreadedCluckObserver>();
+        auto secondObserver = winrt::make_self<FreeThreadedCluckObserver>();
+        EXPECT_CALL(*firstObserver, OnCluck()).WillOnce(Invoke([&first] {
+            first.set_value();
+            return S_OK;
+        }));
+        EXPECT_CALL(*secondObserver, OnCluck()).WillOnce(Invoke([&second] {
+            second.set_value();
+            return S_OK;
+        }));
+
+        unsigned long firstCookie = 0;
+        unsigned long secondCookie = 0;
+        HR(hen->Subscribe(firstObserver.get(), &firstCookie));
+        HR(hen->Subscribe(secondObserver.get(), &secondCookie));
+        EXPECT_NE(firstCookie, secondCookie);
+
+        HR(hen->Cluck());
+        EXPECT_EQ(first.get_future().wait_for(std::chrono::seconds(10)), std::future_status::ready);
+        EXPECT_EQ(second.get_future().wait_for(std::chrono::seconds(10)), std::future_status::ready);
+
+        HR(hen->Unsubscribe(firstCookie));
+        return hen->Unsubscribe(firstCookie);
+    });
+
+    EXPECT_EQ(result.get(), CONNECT_E_NOCONNECTION);
+}
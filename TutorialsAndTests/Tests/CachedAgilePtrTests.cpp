@@ -0,0 +1,77 @@
+#include <ComUtility/CachedAgilePtr.h>
+#include <ComUtility/ComFactory.h>
+#include <ComUtility/Utility.h>
+#include <Interfaces/IHen.h>
+#include <AtlServer/AtlServer.h>
+#include <gtest/gtest.h>
+#include <optional>
+#include <thread>
+#include <wrl.h>
+#include "Mocks/IPostmanMock.h"
+using Microsoft::WRL::ComPtr;
+
+TEST(CachedAgilePtrTests,
+    RequireThat_Get_ReturnsSameProxy_WhenCalledTwiceOnSameThread)
+{
+    ComFactory factory;
+    ComPtr<IHen> hen;
+    ASSERT_HRESULT_SUCCEEDED(factory.CreateInstance(__uuidof(AtlHen), nullptr, __uuidof(IHen), reinterpret_cast<void**>(hen.GetAddressOf())));
+    const CachedAgilePtr<IHen> agile{hen.Get()};
+
+    std::thread worker{[&] {
+        ComRuntime runtime{Apartment::MultiThreaded};
+
+        const auto first = agile.Get();
+        const auto second = agile.Get();
+
+        EXPECT_EQ(first.p, second.p);
+        EXPECT_HRESULT_SUCCEEDED(second->Cluck());
+    }};
+    worker.join();
+}
+
+TEST(CachedAgilePtrTests,
+    RequireThat_Get_ResolvesNewProxy_AfterThreadLeftCom)
+{
+    ComFactory factory;
+    ComPtr<IHen> hen;
+    ASSERT_HRESULT_SUCCEEDED(factory.CreateInstance(__uuidof(AtlHen), nullptr, __uuidof(IHen), reinterpret_cast<void**>(hen.GetAddressOf())));
+    const CachedAgilePtr<IHen> agile{hen.Get()};
+
+    std::thread worker{[&] {
+        {
+            ComRuntime runtime{Apartment::MultiThreaded};
+            EXPECT_HRESULT_SUCCEEDED(agile.Get()->Cluck());
+        }
+
+        // The proxy from the first session belonged to an apartment that no longer exists
+        ComRuntime runtime{Apartment::SingleThreaded};
+        EXPECT_HRESULT_SUCCEEDED(agile.Get()->Cluck());
+    }};
+    worker.join();
+}
+
+TEST(CachedAgilePtrTests,
+    RequireThat_Get_ReleasesInterfacesOfDestroyedPointers_OnNextLookup)
+{
+    std::thread worker{[] {
+        ComRuntime runtime{Apartment::MultiThreaded};
+        const auto postman = wrl::Make<IPostmanMock>();
+        const auto refCount = [&postman] {
+            postman->AddRef();
+            return postman->Release();
+        };
+        const auto before = refCount();
+
+        std::optional<CachedAgilePtr<IPostman>> agile{postman.Get()};
+        agile->Get();
+        agile.reset();
+        EXPECT_GT(refCount(), before); // Still cached on this thread
+
+        const auto other = wrl::Make<IPostmanMock>();
+        const CachedAgilePtr<IPostman> otherAgile{other.Get()};
+        otherAgile.Get();
+        EXPECT_EQ(refCount(), before);
+    }};
+    worker.join();
+}
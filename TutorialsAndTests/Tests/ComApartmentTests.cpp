@@ -0,0 +1,294 @@
+#include <ComUtility/ComApartment.h>
+#include <ComUtility/Coroutine.h>
+#include <ComUtility/Utility.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <stop_token>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    std::thread::id ThreadOf(ComApartment& apartment)
+    {
+        std::thread::id thread;
+        HR(apartment.Invoke([&thread] {
+            thread = std::this_thread::get_id();
+            return S_OK;
+        }).get());
+        return thread;
+    }
+
+    TaskFuture<std::thread::id> ThreadAfterSchedule(ComApartment& apartment)
+    {
+        co_await apartment.Schedule();
+        co_return std::this_thread::get_id();
+    }
+
+    /** Moves to the apartment, and awaits the value there */
+    TaskFuture<int> AwaitOn(ComApartment& apartment, TaskFuture<int> value)
+    {
+        co_await apartment.Schedule();
+        co_return co_await std::move(value);
+    }
+
+    /** Moves to the first apartment, awaits a call on the second, and returns the thread it resumed on */
+    TaskFuture<std::thread::id> ThreadAfterHop(ComApartment& first, ComApartment& second)
+    {
+        co_await first.Schedule();
+        HR(co_await second.InvokeAsync([] { return S_OK; }));
+        co_return std::this_thread::get_id();
+    }
+}
+
+TEST(ComApartmentTests,
+    RequireThat_Schedule_ResumesCoroutineOnApartmentThread)
+{
+    ComApartment apartment;
+
+    EXPECT_EQ(ThreadOf(apartment), ThreadAfterSchedule(apartment).get());
+}
+
+TEST(ComApartmentTests,
+    RequireThat_InvokeAsync_ResumesCoroutineOnAwaitingApartment)
+{
+    ComApartment first;
+    ComApartment second;
+
+    EXPECT_EQ(ThreadOf(first), ThreadAfterHop(first, second).get());
+}
+
+TEST(ComApartmentTests,
+    RequireThat_GetMetrics_CountsTasks)
+{
+    ComApartment apartment;
+    const auto before = apartment.GetMetrics();
+
+    for (int i = 0; i < 10; ++i)
+        HR(apartment.Invoke([] { return S_OK; }).get());
+
+    const auto after = apartment.GetMetrics();
+    EXPECT_EQ(before.submitted + 10, after.submitted);
+    EXPECT_EQ(before.completed + 10, after.completed);
+    EXPECT_EQ(before.runTime.count + 10, after.runTime.count);
+    EXPECT_EQ(0u, after.queueDepth);
+}
+
+TEST(ComApartmentTests,
+    RequireThat_Invoke_RunsInteractiveTask_BeforeQueuedBackgroundTasks)
+{
+    ComApartment apartment;
+    std::vector<char> order;
+
+    // Keep the apartment busy, so that the tasks below are queued together
+    Event release{CreateEvent(nullptr, TRUE, FALSE, nullptr)};
+    auto blocker = apartment.Invoke([&release] {
+        WaitForSingleObject(release.Get(), INFINITE);
+        return S_OK;
+    });
+
+    auto background = apartment.Invoke(TaskPriority::Background, [&order] {
+        order.push_back('b');
+        return S_OK;
+    });
+    auto interactive = apartment.Invoke(TaskPriority::Interactive, [&order] {
+        order.push_back('i');
+        return S_OK;
+    });
+
+    SetEvent(release.Get());
+    HR(blocker.get());
+    HR(background.get());
+    HR(interactive.get());
+
+    EXPECT_EQ((std::vector<char>{'i', 'b'}), order);
+}
+
+TEST(ComApartmentTests,
+    RequireThat_Invoke_DropsCancelledAndExpiredTasks)
+{
+    ComApartment apartment;
+    int calls = 0;
+
+    // Keep the apartment busy while the tasks below are cancelled or expire
+    Event release{CreateEvent(nullptr, TRUE, FALSE, nullptr)};
+    auto blocker = apartment.Invoke([&release] {
+        WaitForSingleObject(release.Get(), INFINITE);
+        return S_OK;
+    });
+
+    std::stop_source cancellation;
+    auto cancelled = apartment.Invoke({.cancellation = cancellation.get_token()}, [&calls] {
+        ++calls;
+        return S_OK;
+    });
+    auto expired = apartment.Invoke({.deadline = TaskMetrics::Clock::now()}, [&calls] {
+        ++calls;
+        return S_OK;
+    });
+    auto kept = apartment.Invoke({.deadline = TaskMetrics::Clock::now() + std::chrono::hours{1}}, [&calls] {
+        ++calls;
+        return S_OK;
+    });
+
+    cancellation.request_stop();
+    SetEvent(release.Get());
+    HR(blocker.get());
+
+    EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_CANCELLED), cancelled.get());
+    EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_TIMEOUT), expired.get());
+    EXPECT_EQ(S_OK, kept.get());
+    EXPECT_EQ(1, calls);
+    EXPECT_EQ(2u, apartment.GetMetrics().dropped);
+}
+
+TEST(ComApartmentTests,
+    RequireThat_Post_ReportsFailuresToErrorSink)
+{
+    std::vector<HRESULT> errors; // Only touched on the apartment thread until it is joined
+    {
+        ComApartment apartment{[&errors](HRESULT result) { errors.push_back(result); }};
+
+        int calls = 0;
+        apartment.Post([&calls] {
+            ++calls;
+            return S_OK;
+        });
+        apartment.Post([] { return E_ACCESSDENIED; });
+        apartment.Post([] { return E_INVALIDARG; });
+
+        // Tasks run in order, so the posted tasks have run when this returns
+        HR(apartment.Invoke([] { return S_OK; }).get());
+        EXPECT_EQ(1, calls);
+    }
+
+    EXPECT_EQ((std::vector<HRESULT>{E_ACCESSDENIED, E_INVALIDARG}), errors);
+}
+
+TEST(ComApartmentTests,
+    RequireThat_Invoke_Throws_WhenQueueIsFullAndFailingFast)
+{
+    ComApartment apartment{QueueLimits{.capacity = 1, .overflow = OverflowPolicy::FailFast}};
+
+    Event release{CreateEvent(nullptr, TRUE, FALSE, nullptr)};
+    auto blocker = apartment.Invoke([&release] {
+        WaitForSingleObject(release.Get(), INFINITE);
+        return S_OK;
+    });
+
+    // The blocker has left the queue once it runs, so wait for the queue to be empty
+    while (apartment.QueueDepth() != 0)
+        std::this_thread::yield();
+
+    auto queued = apartment.Invoke([] { return S_OK; });
+    EXPECT_THROW(apartment.Invoke([] { return S_OK; }), std::system_error);
+
+    SetEvent(release.Get());
+    HR(blocker.get());
+    HR(queued.get());
+}
+
+TEST(ComApartmentTests,
+    RequireThat_AwaitingCoroutine_IsResumed_WhenQueueIsFullAndFailingFast)
+{
+    ComApartment apartment{QueueLimits{.capacity = 1, .overflow = OverflowPolicy::FailFast}};
+    TaskPromise<int> promise;
+    auto result = AwaitOn(apartment, promise.get_future());
+    while (apartment.QueueDepth() != 0)
+        std::this_thread::yield();
+
+    Event release{CreateEvent(nullptr, TRUE, FALSE, nullptr)};
+    auto blocker = apartment.Invoke([&release] {
+        WaitForSingleObject(release.Get(), INFINITE);
+        return S_OK;
+    });
+    while (apartment.QueueDepth() != 0)
+        std::this_thread::yield();
+
+    auto queued = apartment.Invoke([] { return S_OK; });
+    EXPECT_THROW(apartment.Invoke([] { return S_OK; }), std::system_error);
+
+    // Resuming the coroutine must neither throw nor block, although the queue is full
+    promise.set_value(42);
+
+    SetEvent(release.Get());
+    HR(blocker.get());
+    HR(queued.get());
+    EXPECT_EQ(42, result.get());
+}
+
+TEST(ComApartmentTests,
+    RequireThat_Destructor_RejectsTasksThatHaveNotStarted)
+{
+    Event release{CreateEvent(nullptr, TRUE, FALSE, nullptr)};
+    TaskFuture<HRESULT> blocker;
+    TaskFuture<HRESULT> pending;
+    std::thread releaser;
+    int calls = 0;
+    {
+        ComApartment apartment;
+        blocker = apartment.Invoke([&release] {
+            WaitForSingleObject(release.Get(), INFINITE);
+            return S_OK;
+        });
+        pending = apartment.Invoke([&calls] {
+            ++calls;
+            return S_OK;
+        });
+
+        // Let the blocker finish after the destructor has requested shutdown
+        releaser = std::thread([&release] {
+            std::this_thread::sleep_for(std::chrono::milliseconds{50});
+            SetEvent(release.Get());
+        });
+    }
+    releaser.join();
+
+    EXPECT_EQ(S_OK, blocker.get());
+    EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_OPERATION_ABORTED), pending.get());
+    EXPECT_EQ(0, calls);
+}
+
+TEST(ComApartmentTests,
+    RequireThat_AwaitingCoroutine_ThrowsOperationCanceled_WhenApartmentShutsDownBeforeResuming)
+{
+    Event release{CreateEvent(nullptr, TRUE, FALSE, nullptr)};
+    TaskPromise<int> promise;
+    TaskFuture<int> result;
+    TaskFuture<HRESULT> blocker;
+    std::thread releaser;
+    {
+        ComApartment apartment;
+        result = AwaitOn(apartment, promise.get_future());
+        blocker = apartment.Invoke([&release] {
+            WaitForSingleObject(release.Get(), INFINITE);
+            return S_OK;
+        });
+
+        // Once the blocker runs, the coroutine is suspended on the promise. Resuming it
+        // queues the coroutine behind the blocker.
+        while (apartment.QueueDepth() != 0)
+            std::this_thread::yield();
+        promise.set_value(42);
+
+        // Let the blocker finish after the destructor has requested shutdown
+        releaser = std::thread([&release] {
+            std::this_thread::sleep_for(std::chrono::milliseconds{50});
+            SetEvent(release.Get());
+        });
+    }
+    releaser.join();
+
+    EXPECT_EQ(S_OK, blocker.get());
+    ASSERT_TRUE(result.is_ready()) << "The coroutine must not be leaked";
+    try
+    {
+        result.get();
+        FAIL() << "Expected the co_await to throw";
+    }
+    catch (const std::system_error& e)
+    {
+        EXPECT_EQ(e.code(), std::errc::operation_canceled);
+    }
+}
@@ -3,6 +3,8 @@
 #include <Interfaces/IHen.h>
 #include <AtlServer/AtlServer.h>
 #include <gtest/gtest.h>
+#include <thread>
+#include <vector>
 #include <wrl.h>
 using Microsoft::WRL::ComPtr;
 
@@ -28,4 +30,110 @@ TEST(ComApartmentTests,
     }
 
     EXPECT_EQ(RPC_E_SERVER_DIED_DNE, hen->Cluck());
-}
\ No newline at end of file
+}
+
+TEST(ComApartmentTests,
+    RequireThat_CreateInstance_WithAffinityKey_CreatesInstancesOnPool)
+{
+    ComFactory factory{ApartmentPoolOptions{2, 2, Placement::AffinityKey}};
+    EXPECT_EQ(2u, factory.ApartmentCount());
+
+    for (size_t key = 0; key < 4; ++key)
+    {
+        ComPtr<IHen> hen;
+        ASSERT_HRESULT_SUCCEEDED(factory.CreateInstance(key, __uuidof(AtlHen), nullptr, __uuidof(IHen), reinterpret_cast<void**>(hen.GetAddressOf())));
+        HR(hen->Cluck());
+    }
+}
+
+TEST(ComApartmentTests,
+    RequireThat_CreateInstances_CreatesBatchOfInstances)
+{
+    ComFactory factory;
+    std::vector<IHen*> hens(10);
+
+    ASSERT_HRESULT_SUCCEEDED(factory.CreateInstances(__uuidof(AtlHen), __uuidof(IHen), hens.size(), reinterpret_cast<void**>(hens.data())));
+
+    for (const auto hen : hens)
+    {
+        ComPtr<IHen> owner;
+        owner.Attach(hen);
+        HR(owner->Cluck());
+    }
+}
+
+TEST(ComApartmentTests,
+    RequireThat_CreateInstances_ReturnsNothing_WhenCreationFails)
+{
+    ComFactory factory;
+    std::vector<IUnknown*> objects(3);
+
+    EXPECT_EQ(REGDB_E_CLASSNOTREG, factory.CreateInstances(GUID_NULL, __uuidof(IUnknown), objects.size(), reinterpret_cast<void**>(objects.data())));
+    EXPECT_EQ(std::vector<IUnknown*>(3), objects);
+}
+
+TEST(ComApartmentTests,
+    RequireThat_CreateInstance_CreatesInstance_AfterClassFactoryIsInvalidated)
+{
+    ComFactory factory;
+    for (int i = 0; i < 2; ++i)
+    {
+        ComPtr<IHen> hen;
+        ASSERT_HRESULT_SUCCEEDED(factory.CreateInstance(__uuidof(AtlHen), nullptr, __uuidof(IHen), reinterpret_cast<void**>(hen.GetAddressOf())));
+        HR(hen->Cluck());
+
+        EXPECT_HRESULT_SUCCEEDED(factory.InvalidateClassFactory(__uuidof(AtlHen)));
+    }
+
+    EXPECT_HRESULT_SUCCEEDED(factory.InvalidateClassFactories());
+}
+
+TEST(ComApartmentTests,
+    RequireThat_SharedInstance_CanBeUsedFromManyThreads)
+{
+    ComFactory factory;
+    SharedInstance shared;
+    ASSERT_HRESULT_SUCCEEDED(factory.CreateSharedInstance(__uuidof(AtlHen), __uuidof(IHen), shared));
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < 8; ++i)
+    {
+        workers.emplace_back([&shared] {
+            ComRuntime runtime{Apartment::MultiThreaded};
+            ComPtr<IHen> hen;
+            EXPECT_HRESULT_SUCCEEDED(shared.Get(hen.GetAddressOf()));
+            EXPECT_HRESULT_SUCCEEDED(hen->Cluck());
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    ComPtr<IHen> hen;
+    EXPECT_HRESULT_SUCCEEDED(shared.Get(hen.GetAddressOf()));
+    EXPECT_HRESULT_SUCCEEDED(hen->Cluck());
+}
+
+TEST(ComApartmentTests,
+    RequireThat_SharedInstance_ReturnsSameProxy_WhenCalledTwiceOnSameThread)
+{
+    ComFactory factory;
+    SharedInstance shared;
+    ASSERT_HRESULT_SUCCEEDED(factory.CreateSharedInstance(__uuidof(AtlHen), __uuidof(IHen), shared));
+
+    ComPtr<IHen> first;
+    ComPtr<IHen> second;
+    ASSERT_HRESULT_SUCCEEDED(shared.Get(first.GetAddressOf()));
+    ASSERT_HRESULT_SUCCEEDED(shared.Get(second.GetAddressOf()));
+
+    EXPECT_EQ(first.Get(), second.Get());
+}
+
+TEST(ComApartmentTests,
+    RequireThat_SharedInstance_ReturnsInvalidHandle_WhenEmpty)
+{
+    const SharedInstance shared;
+    ComPtr<IHen> hen;
+
+    EXPECT_FALSE(shared);
+    EXPECT_EQ(E_HANDLE, shared.Get(hen.GetAddressOf()));
+}
@@ -0,0 +1,215 @@
+#include <ComUtility/Coroutine.h>
+#include <ComUtility/WorkStealingPool.h>
+#include <gtest/gtest.h>
+#include <deque>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace
+{
+    /** Executor that queues work until the test runs it, and registers itself as the
+     * current executor while running */
+    class ManualExecutor final : public Executor
+    {
+    public:
+        void Execute(void (*function)(void*), void (*cancel)(void*), void* data) override
+        {
+            if (refuse)
+                throw std::system_error(std::make_error_code(std::errc::operation_canceled));
+            m_work.push_back({function, cancel, data});
+        }
+
+        /** Run queued work, including work that is queued while running */
+        size_t RunAll()
+        {
+            const CurrentScope scope{this};
+            size_t count = 0;
+            while (!m_work.empty())
+            {
+                const auto work = m_work.front();
+                m_work.pop_front();
+                work.function(work.data);
+                ++count;
+            }
+            return count;
+        }
+
+        /** Drop queued work, like an executor that shuts down */
+        size_t CancelAll()
+        {
+            size_t count = 0;
+            while (!m_work.empty())
+            {
+                const auto work = m_work.front();
+                m_work.pop_front();
+                work.cancel(work.data);
+                ++count;
+            }
+            return count;
+        }
+
+        /** Run a function as if it was running on the executor */
+        template <typename Function>
+        auto RunOn(Function&& function)
+        {
+            const CurrentScope scope{this};
+            return function();
+        }
+
+        bool refuse = false; ///< Throw from Execute, like an executor that has shut down
+
+    private:
+        struct Work
+        {
+            void (*function)(void*);
+            void (*cancel)(void*);
+            void* data;
+        };
+
+        std::deque<Work> m_work;
+    };
+
+    TaskFuture<int> AddOne(TaskFuture<int> value)
+    {
+        co_return co_await std::move(value) + 1;
+    }
+
+    TaskFuture<std::thread::id> ThreadAfterSchedule(Executor& executor)
+    {
+        co_await ResumeOn{executor};
+        co_return std::this_thread::get_id();
+    }
+
+    TaskFuture<std::thread::id> ThreadAfterAwait(TaskFuture<int> value)
+    {
+        co_await std::move(value);
+        co_return std::this_thread::get_id();
+    }
+
+    TaskFuture<void> Throw()
+    {
+        throw std::runtime_error("failure");
+        co_return;
+    }
+}
+
+TEST(CoroutineTests,
+    RequireThat_Coroutine_ReturnsTaskFuture_ThatCanBeWaitedFor)
+{
+    TaskPromise<int> promise;
+    auto result = AddOne(promise.get_future());
+    EXPECT_FALSE(result.is_ready());
+
+    promise.set_value(41);
+
+    EXPECT_EQ(result.get(), 42);
+}
+
+TEST(CoroutineTests,
+    RequireThat_Coroutine_StoresException)
+{
+    EXPECT_THROW(Throw().get(), std::runtime_error);
+}
+
+TEST(CoroutineTests,
+    RequireThat_Await_DoesNotSuspend_WhenFutureIsReady)
+{
+    TaskPromise<int> promise;
+    auto value = promise.get_future();
+    promise.set_value(1);
+
+    ManualExecutor executor;
+    auto result = executor.RunOn([&] { return AddOne(std::move(value)); });
+
+    EXPECT_TRUE(result.is_ready());
+    EXPECT_EQ(executor.RunAll(), 0u);
+    EXPECT_EQ(result.get(), 2);
+}
+
+TEST(CoroutineTests,
+    RequireThat_Await_ResumesOnExecutorOfAwaitingThread)
+{
+    ManualExecutor executor;
+    TaskPromise<int> promise;
+
+    auto result = executor.RunOn([&] { return AddOne(promise.get_future()); });
+
+    // Completing the promise on another thread must not resume the coroutine there
+    std::thread{[&] { promise.set_value(1); }}.join();
+    EXPECT_FALSE(result.is_ready());
+
+    EXPECT_EQ(executor.RunAll(), 1u);
+    EXPECT_EQ(result.get(), 2);
+}
+
+TEST(CoroutineTests,
+    RequireThat_Await_ThrowsOperationCanceled_WhenExecutorCanNotResumeCoroutine)
+{
+    ManualExecutor executor;
+    TaskPromise<int> promise;
+
+    auto result = executor.RunOn([&] { return AddOne(promise.get_future()); });
+
+    // The coroutine is resumed on this thread instead of being leaked
+    executor.refuse = true;
+    promise.set_value(1);
+
+    ASSERT_TRUE(result.is_ready());
+    try
+    {
+        result.get();
+        FAIL() << "Expected the co_await to throw";
+    }
+    catch (const std::system_error& e)
+    {
+        EXPECT_EQ(e.code(), std::errc::operation_canceled);
+    }
+}
+
+TEST(CoroutineTests,
+    RequireThat_ResumeOn_ThrowsOperationCanceled_WhenExecutorDropsCoroutine)
+{
+    ManualExecutor executor;
+    auto result = ThreadAfterSchedule(executor);
+
+    EXPECT_EQ(executor.CancelAll(), 1u);
+
+    ASSERT_TRUE(result.is_ready());
+    try
+    {
+        result.get();
+        FAIL() << "Expected the co_await to throw";
+    }
+    catch (const std::system_error& e)
+    {
+        EXPECT_EQ(e.code(), std::errc::operation_canceled);
+    }
+}
+
+TEST(CoroutineTests,
+    RequireThat_ResumeOn_MovesCoroutineToPool)
+{
+    WorkStealingPool<> pool{1};
+    const auto worker = pool.Submit([] { return std::this_thread::get_id(); }).get();
+
+    EXPECT_EQ(ThreadAfterSchedule(pool).get(), worker);
+}
+
+TEST(CoroutineTests,
+    RequireThat_AwaitOnPool_ResumesOnPool_WithoutBlockingWorker)
+{
+    WorkStealingPool<> pool{1};
+    TaskPromise<int> promise;
+
+    // The only worker is free to run other tasks while the coroutine is suspended
+    auto result = pool.Submit([&] { return AddOne(promise.get_future()); }).get();
+    const auto worker = pool.Submit([] { return std::this_thread::get_id(); }).get();
+
+    auto resumedOn = pool.Submit([&] { return ThreadAfterAwait(std::move(result)); }).get();
+
+    promise.set_value(1);
+
+    EXPECT_EQ(resumedOn.get(), worker);
+}
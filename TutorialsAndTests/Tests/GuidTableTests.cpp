@@ -0,0 +1,119 @@
+#include <ComUtility/GuidTable.h>
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace
+{
+    /** Same fields as the GUID structure of Windows */
+    struct WindowsGuid
+    {
+        unsigned long Data1;
+        unsigned short Data2;
+        unsigned short Data3;
+        unsigned char Data4[8];
+    };
+
+    constexpr auto GuardDog = ParseGuid("d162d2f7-cdf4-44bc-8018-6058420bcfdc");
+    constexpr auto PuppyFarm = ParseGuid("{55dd9580-fcaf-433c-a287-dd995b834065}");
+    constexpr auto Proxy = ParseGuid("69fd604f-493c-4344-94b8-ea4179dd5113");
+
+    constexpr GuidTableEntry<int> Entries[] = {
+        {GuardDog, 1},
+        {PuppyFarm, 2},
+        {ParseGuid("2db739d7-6540-4412-9afa-242fa88ed480"), 3},
+        {ParseGuid("59e7b6b6-ac1a-4af4-b09c-7de483c7a5ad"), 4},
+        {ParseGuid("d6ae480c-8b07-41f0-bea4-9eb3c7ed8d91"), 5},
+    };
+
+    constexpr auto Table = MakeGuidTable(Entries);
+
+    // Lookups are constant expressions, so a table can be checked when it is built
+    static_assert(*Table.Find(GuardDog) == 1);
+    static_assert(*Table.Find(PuppyFarm) == 2);
+    static_assert(Table.Find(Proxy) == nullptr);
+    static_assert(HashGuid(GuardDog) != HashGuid(PuppyFarm));
+}
+
+TEST(GuidTableTests,
+    RequireThat_ParseGuid_ReadsAllFields)
+{
+    const auto guid = ParseGuid("d162d2f7-cdf4-44bc-8018-6058420bcfdc");
+
+    EXPECT_EQ(guid.data1, 0xd162d2f7u);
+    EXPECT_EQ(guid.data2, 0xcdf4u);
+    EXPECT_EQ(guid.data3, 0x44bcu);
+    const uint8_t data4[] = {0x80, 0x18, 0x60, 0x58, 0x42, 0x0b, 0xcf, 0xdc};
+    for (size_t i = 0; i < 8; ++i)
+        EXPECT_EQ(guid.data4[i], data4[i]);
+}
+
+TEST(GuidTableTests,
+    RequireThat_ParseGuid_IgnoresBracesAndCase)
+{
+    EXPECT_EQ(ParseGuid("{D162D2F7-CDF4-44BC-8018-6058420BCFDC}"), GuardDog);
+}
+
+TEST(GuidTableTests,
+    RequireThat_ParseGuid_Throws_WhenTextIsNotGuid)
+{
+    EXPECT_THROW(ParseGuid(""), std::invalid_argument);
+    EXPECT_THROW(ParseGuid("d162d2f7-cdf4-44bc-8018-6058420bcfd"), std::invalid_argument);
+    EXPECT_THROW(ParseGuid("d162d2f7-cdf4-44bc-8018-6058420bcfdg"), std::invalid_argument);
+    EXPECT_THROW(ParseGuid("d162d2f7+cdf4-44bc-8018-6058420bcfdc"), std::invalid_argument);
+    EXPECT_THROW(ParseGuid("{d162d2f7-cdf4-44bc-8018-6058420bcfdc"), std::invalid_argument);
+}
+
+TEST(GuidTableTests,
+    RequireThat_ToGuidValue_MatchesParsedGuid)
+{
+    const WindowsGuid guid{0xd162d2f7, 0xcdf4, 0x44bc, {0x80, 0x18, 0x60, 0x58, 0x42, 0x0b, 0xcf, 0xdc}};
+
+    EXPECT_EQ(ToGuidValue(guid), GuardDog);
+}
+
+TEST(GuidTableTests,
+    RequireThat_HashGuid_DiffersForGuidsThatDifferInOneByte)
+{
+    std::unordered_set<uint64_t> hashes;
+    for (size_t i = 0; i < 8; ++i)
+    {
+        auto guid = GuardDog;
+        guid.data4[i] ^= 1;
+        hashes.insert(HashGuid(guid));
+    }
+    hashes.insert(HashGuid(GuardDog));
+
+    EXPECT_EQ(hashes.size(), 9u);
+    EXPECT_EQ(std::hash<GuidValue>{}(GuardDog), static_cast<size_t>(HashGuid(GuardDog)));
+}
+
+TEST(GuidTableTests,
+    RequireThat_Find_ReturnsValueOfEveryEntry)
+{
+    for (const auto& entry : Entries)
+    {
+        const auto value = Table.Find(entry.guid);
+        ASSERT_NE(value, nullptr);
+        EXPECT_EQ(*value, entry.value);
+    }
+}
+
+TEST(GuidTableTests,
+    RequireThat_Find_ReturnsNull_WhenGuidIsNotInTable)
+{
+    auto guid = GuardDog;
+    guid.data4[7] ^= 1;
+
+    EXPECT_EQ(Table.Find(guid), nullptr);
+    EXPECT_EQ(Table.Find(GuidValue{}), nullptr);
+}
+
+TEST(GuidTableTests,
+    RequireThat_Constructor_Throws_WhenGuidIsAddedTwice)
+{
+    const GuidTableEntry<int> entries[] = {{GuardDog, 1}, {PuppyFarm, 2}, {GuardDog, 3}};
+
+    EXPECT_THROW(MakeGuidTable(entries), std::invalid_argument);
+}
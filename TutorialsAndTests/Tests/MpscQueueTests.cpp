@@ -0,0 +1,159 @@
+#include <ComUtility/MpscQueue.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+TEST(MpscQueueTests,
+    RequireThat_ConsumeAll_ReturnsElementsInInsertionOrder)
+{
+    MpscQueue<int> queue;
+    for (int i = 0; i < 10; ++i)
+        queue.push_back(i);
+
+    std::vector<int> consumed;
+    EXPECT_EQ(queue.consume_all([&](int value) { consumed.push_back(value); }), 10u);
+
+    EXPECT_EQ(consumed, (std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(MpscQueueTests,
+    RequireThat_Revert_RemovesElement_WhenNotConsumed)
+{
+    MpscQueue<int> queue;
+    queue.push_back(1);
+    auto ticket = queue.push_back(2);
+    queue.push_back(3);
+
+    EXPECT_TRUE(ticket.revert());
+
+    std::vector<int> consumed;
+    queue.consume_all([&](int value) { consumed.push_back(value); });
+    EXPECT_EQ(consumed, (std::vector<int>{1, 3}));
+}
+
+TEST(MpscQueueTests,
+    RequireThat_Revert_Fails_WhenAlreadyConsumed)
+{
+    MpscQueue<int> queue;
+    auto ticket = queue.push_back(1);
+
+    EXPECT_EQ(queue.consume_all([](int) {}), 1u);
+
+    EXPECT_FALSE(ticket.revert());
+}
+
+TEST(MpscQueueTests,
+    RequireThat_ConsumeAll_KeepsRemainingElements_WhenConsumerThrows)
+{
+    MpscQueue<int> queue;
+    queue.push_back(1);
+    auto ticket = queue.push_back(2);
+    queue.push_back(3);
+
+    std::vector<int> consumed;
+    EXPECT_THROW(queue.consume_all([&](int value) {
+        if (value == 2)
+            throw std::bad_alloc();
+        consumed.push_back(value);
+    }), std::bad_alloc);
+    EXPECT_FALSE(queue.empty());
+
+    queue.push_back(4);
+    queue.consume_all([&](int value) { consumed.push_back(value); });
+    EXPECT_EQ(consumed, (std::vector<int>{1, 2, 3, 4}));
+    EXPECT_FALSE(ticket.revert());
+}
+
+TEST(MpscQueueTests,
+    RequireThat_Destructor_ReleasesRemainingElements)
+{
+    const auto elem = std::make_shared<int>(42);
+    {
+        MpscQueue<std::shared_ptr<int>> queue;
+        queue.push_back(elem);
+        EXPECT_EQ(elem.use_count(), 2);
+    }
+    EXPECT_EQ(elem.use_count(), 1);
+}
+
+// Stress test with many producers that verifies that every element is consumed
+// exactly once, in the order each producer pushed them.
+TEST(MpscQueueTests,
+    RequireThat_AllElementsAreConsumedInProducerOrder_WhenPushedConcurrently)
+{
+    constexpr int producerCount = 16;
+    constexpr int elementsPerProducer = 20000;
+
+    struct Element
+    {
+        int producer;
+        int sequence;
+    };
+
+    MpscQueue<Element> queue;
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < producerCount; ++producer)
+    {
+        producers.emplace_back([&queue, producer] {
+            for (int sequence = 0; sequence < elementsPerProducer; ++sequence)
+                queue.push_back({producer, sequence});
+        });
+    }
+
+    std::vector<int> next(producerCount, 0);
+    int consumed = 0;
+    while (consumed < producerCount * elementsPerProducer)
+    {
+        consumed += static_cast<int>(queue.consume_all([&](const Element& elem) {
+            EXPECT_EQ(elem.sequence, next[elem.producer]);
+            next[elem.producer] = elem.sequence + 1;
+        }));
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+
+    EXPECT_TRUE(queue.empty());
+    for (const auto count : next)
+        EXPECT_EQ(count, elementsPerProducer);
+}
+
+// Stress test that verifies that a reverted element is never consumed, and that an
+// element that could not be reverted is consumed exactly once.
+TEST(MpscQueueTests,
+    RequireThat_ElementsAreEitherRevertedOrConsumed_WhenRevertedConcurrently)
+{
+    constexpr int producerCount = 8;
+    constexpr int elementsPerProducer = 20000;
+
+    MpscQueue<int> queue;
+    std::atomic<int> reverted = 0;
+    std::atomic<int> producersDone = 0;
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < producerCount; ++producer)
+    {
+        producers.emplace_back([&] {
+            for (int i = 0; i < elementsPerProducer; ++i)
+            {
+                auto ticket = queue.push_back(i);
+                if (i % 2 == 0 && ticket.revert())
+                    ++reverted;
+            }
+            ++producersDone;
+        });
+    }
+
+    int consumed = 0;
+    while (producersDone < producerCount || !queue.empty())
+        consumed += static_cast<int>(queue.consume_all([](int) {}));
+
+    for (auto& producer : producers)
+        producer.join();
+
+    EXPECT_EQ(consumed + reverted, producerCount * elementsPerProducer);
+}
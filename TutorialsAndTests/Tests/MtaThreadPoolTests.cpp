@@ -0,0 +1,17 @@
+#include <ComUtility/MtaThreadPool.h>
+#include <gtest/gtest.h>
+
+TEST(MtaThreadPoolTests,
+    RequireThat_Submit_RunsTasksInMultithreadedApartment)
+{
+    MtaThreadPool pool{2};
+
+    const auto apartmentType = pool.Submit([] {
+        APTTYPE type{};
+        APTTYPEQUALIFIER qualifier{};
+        HR(CoGetApartmentType(&type, &qualifier));
+        return type;
+    }).get();
+
+    EXPECT_EQ(APTTYPE_MTA, apartmentType);
+}
@@ -0,0 +1,473 @@
+#include <ComUtility/PriorityTaskDispatcher.h>
+#include <ComUtility/TaskMetrics.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    /** Wakeup that counts signals, and can be told to fail */
+    struct CountingWakeup
+    {
+        void Signal()
+        {
+            if (onSignal)
+                std::exchange(onSignal, nullptr)();
+            if (fail)
+                throw std::runtime_error("Wakeup failed");
+            if (failures > 0)
+            {
+                --failures;
+                throw std::runtime_error("Wakeup failed");
+            }
+            ++signalCount;
+        }
+
+        bool fail = false;
+        int failures = 0;                ///< Number of signals that fail before signals succeed again
+        std::function<void()> onSignal;  ///< Called once, in the next signal
+        int signalCount = 0;
+    };
+
+    using Task = std::function<void()>;
+    using Dispatcher = PriorityTaskDispatcher<Task, CountingWakeup>;
+
+    size_t RunAll(Dispatcher& dispatcher)
+    {
+        return dispatcher.Drain([](Task& task) { task(); });
+    }
+
+    /** A consumer thread that drains a dispatcher with two lanes */
+    class Worker final
+    {
+    public:
+        Worker() : m_tasks{4, {}}
+        {
+            m_thread = std::thread([this] {
+                while (!m_stop)
+                {
+                    m_tasks.GetWakeup().Wait();
+                    m_tasks.Drain([](Task& task) { task(); });
+                }
+            });
+        }
+
+        ~Worker()
+        {
+            Submit(TaskPriority::Background, [this] { m_stop = true; });
+            m_thread.join();
+        }
+
+        void Submit(TaskPriority priority, Task task)
+        {
+            m_tasks.Submit(priority, std::move(task));
+        }
+
+        size_t PendingCount(TaskPriority priority) const
+        {
+            return m_tasks.PendingCount(priority);
+        }
+
+    private:
+        PriorityTaskDispatcher<Task, ConditionVariableWakeup> m_tasks;
+        std::thread m_thread;
+        bool m_stop = false; ///< Only used on the worker thread
+    };
+
+    /** p99 of the time interactive tasks wait in the queue, with optional background load */
+    std::chrono::nanoseconds InteractiveP99(bool saturateBackground)
+    {
+        using Clock = std::chrono::steady_clock;
+        constexpr auto backgroundTaskDuration = std::chrono::microseconds{500};
+        constexpr int interactiveTasks = 100;
+
+        LatencyHistogram latency;
+        std::atomic<int> interactiveDone = 0;
+        {
+            Worker worker;
+            if (saturateBackground)
+            {
+                // Far more background work than the test runs for
+                for (int i = 0; i < 400; ++i)
+                    worker.Submit(TaskPriority::Background, [=] { std::this_thread::sleep_for(backgroundTaskDuration); });
+            }
+
+            for (int i = 0; i < interactiveTasks; ++i)
+            {
+                const auto submitted = Clock::now();
+                worker.Submit(TaskPriority::Interactive, [&latency, &interactiveDone, submitted] {
+                    latency.Record(Clock::now() - submitted);
+                    ++interactiveDone;
+                });
+                std::this_thread::sleep_for(std::chrono::microseconds{200});
+            }
+
+            while (interactiveDone != interactiveTasks)
+                std::this_thread::yield();
+
+            // The background lane must still be saturated for the measurement to mean anything
+            if (saturateBackground)
+            {
+                EXPECT_NE(0u, worker.PendingCount(TaskPriority::Background));
+            }
+        }
+        return latency.GetSnapshot().Percentile(99);
+    }
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_Submit_SignalsOnce_WhenManyTasksAreSubmittedBeforeDrain)
+{
+    Dispatcher dispatcher{4, {}};
+
+    int executed = 0;
+    for (int i = 0; i < 10000; ++i)
+        dispatcher.Submit(TaskPriority::Interactive, [&] { ++executed; });
+
+    EXPECT_EQ(dispatcher.GetWakeup().signalCount, 1);
+
+    EXPECT_EQ(RunAll(dispatcher), 10000u);
+    EXPECT_EQ(executed, 10000);
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_Submit_SignalsAgain_WhenQueueWasDrained)
+{
+    Dispatcher dispatcher{4, {}};
+
+    dispatcher.Submit(TaskPriority::Interactive, [] {});
+    RunAll(dispatcher);
+    dispatcher.Submit(TaskPriority::Interactive, [] {});
+
+    EXPECT_EQ(dispatcher.GetWakeup().signalCount, 2);
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_AllTasksAreExecuted_WhenSubmittedConcurrentlyToWaitingConsumer)
+{
+    constexpr int producerCount = 8;
+    constexpr int tasksPerProducer = 10000;
+
+    PriorityTaskDispatcher<Task, ConditionVariableWakeup> dispatcher{4, {}};
+
+    int executed = 0;
+    std::thread consumer{[&] {
+        while (executed < producerCount * tasksPerProducer)
+        {
+            dispatcher.GetWakeup().Wait();
+            dispatcher.Drain([](Task& task) { task(); });
+        }
+    }};
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < producerCount; ++producer)
+    {
+        producers.emplace_back([&, producer] {
+            const auto priority = producer % 2 ? TaskPriority::Background : TaskPriority::Interactive;
+            for (int i = 0; i < tasksPerProducer; ++i)
+                dispatcher.Submit(priority, [&] { ++executed; }); // Only modified on consumer thread
+        });
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+    consumer.join();
+
+    EXPECT_EQ(executed, producerCount * tasksPerProducer);
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_Drain_RunsInteractiveTasksBeforeBackgroundTasks)
+{
+    Dispatcher dispatcher{4, {}};
+    std::string order;
+
+    dispatcher.Submit(TaskPriority::Background, [&] { order += 'b'; });
+    dispatcher.Submit(TaskPriority::Interactive, [&] { order += 'i'; });
+    dispatcher.Submit(TaskPriority::Background, [&] { order += 'B'; });
+    dispatcher.Submit(TaskPriority::Interactive, [&] { order += 'I'; });
+
+    EXPECT_EQ(4u, RunAll(dispatcher));
+    EXPECT_EQ("iIbB", order);
+    EXPECT_EQ(1, dispatcher.GetWakeup().signalCount);
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_Drain_RunsInteractiveTaskSubmittedDuringDrain_BeforeNextBackgroundTask)
+{
+    Dispatcher dispatcher{4, {}};
+    std::string order;
+
+    dispatcher.Submit(TaskPriority::Background, [&] {
+        order += 'b';
+        dispatcher.Submit(TaskPriority::Interactive, [&] { order += 'i'; });
+    });
+    dispatcher.Submit(TaskPriority::Background, [&] { order += 'B'; });
+
+    EXPECT_EQ(3u, RunAll(dispatcher));
+    EXPECT_EQ("biB", order);
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_Drain_RunsBackgroundTask_AfterInteractiveBurst)
+{
+    Dispatcher dispatcher{3, {}};
+    std::string order;
+
+    dispatcher.Submit(TaskPriority::Background, [&] { order += 'b'; });
+    for (int i = 0; i < 7; ++i)
+        dispatcher.Submit(TaskPriority::Interactive, [&] { order += 'i'; });
+
+    EXPECT_EQ(8u, RunAll(dispatcher));
+    EXPECT_EQ("iiibiiii", order);
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_Drain_DoesNotRunBackgroundTasksSubmittedDuringDrain)
+{
+    Dispatcher dispatcher{4, {}};
+    int executed = 0;
+
+    dispatcher.Submit(TaskPriority::Background, [&] {
+        ++executed;
+        dispatcher.Submit(TaskPriority::Background, [&] { ++executed; });
+    });
+
+    EXPECT_EQ(1u, RunAll(dispatcher));
+    EXPECT_EQ(1u, dispatcher.PendingCount(TaskPriority::Background));
+    EXPECT_EQ(2, dispatcher.GetWakeup().signalCount);
+
+    EXPECT_EQ(1u, RunAll(dispatcher));
+    EXPECT_EQ(2, executed);
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_PendingCount_CountsEachLane)
+{
+    Dispatcher dispatcher{4, {}};
+
+    dispatcher.Submit(TaskPriority::Interactive, [] {});
+    dispatcher.Submit(TaskPriority::Background, [] {});
+    dispatcher.Submit(TaskPriority::Background, [] {});
+
+    EXPECT_EQ(1u, dispatcher.PendingCount(TaskPriority::Interactive));
+    EXPECT_EQ(2u, dispatcher.PendingCount(TaskPriority::Background));
+    EXPECT_EQ(3u, dispatcher.PendingCount());
+
+    RunAll(dispatcher);
+    EXPECT_EQ(0u, dispatcher.PendingCount());
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_Submit_RevertsTaskAndThrows_WhenWakeupFails)
+{
+    Dispatcher dispatcher{4, {}};
+    dispatcher.GetWakeup().fail = true;
+
+    EXPECT_THROW(dispatcher.Submit(TaskPriority::Background, [] {}), std::runtime_error);
+    EXPECT_EQ(0u, dispatcher.PendingCount());
+
+    dispatcher.GetWakeup().fail = false;
+    int executed = 0;
+    dispatcher.Submit(TaskPriority::Interactive, [&] { ++executed; });
+
+    EXPECT_EQ(1u, RunAll(dispatcher));
+    EXPECT_EQ(1, executed);
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_CoalescedTaskIsSignaled_WhenWakeupOfOtherProducerFails)
+{
+    Dispatcher dispatcher{4, {}};
+    auto& wakeup = dispatcher.GetWakeup();
+    wakeup.failures = 1;
+
+    // A second producer submits while the first is signaling, and sees the wakeup in flight
+    int executed = 0;
+    wakeup.onSignal = [&] { dispatcher.Submit(TaskPriority::Background, [&] { ++executed; }); };
+
+    EXPECT_THROW(dispatcher.Submit(TaskPriority::Background, [] {}), std::runtime_error);
+
+    EXPECT_EQ(wakeup.signalCount, 1) << "The first producer must signal again for the task of the second";
+    EXPECT_EQ(dispatcher.Drain([](Task& task) { task(); }), 1u);
+    EXPECT_EQ(executed, 1);
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_InteractiveLatency_StaysFlat_WhenBackgroundLaneIsSaturated)
+{
+    const auto idle = InteractiveP99(false);
+    const auto saturated = InteractiveP99(true);
+
+    // An interactive task waits for at most one background task of 0.5 ms. With a single
+    // FIFO queue it would wait for the whole background backlog of about 200 ms.
+    // The bound leaves room for scheduling noise on a loaded machine.
+    EXPECT_LT(saturated, idle + std::chrono::milliseconds{20});
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_Submit_Throws_WhenFullAndFailingFast)
+{
+    Dispatcher dispatcher{4, QueueLimits{.capacity = 2, .overflow = OverflowPolicy::FailFast}};
+
+    dispatcher.Submit(TaskPriority::Interactive, [] {});
+    dispatcher.Submit(TaskPriority::Background, [] {});
+    EXPECT_THROW(dispatcher.Submit(TaskPriority::Interactive, [] {}), std::system_error);
+    EXPECT_EQ(2u, dispatcher.PendingCount());
+
+    EXPECT_EQ(2u, RunAll(dispatcher));
+    EXPECT_NO_THROW(dispatcher.Submit(TaskPriority::Interactive, [] {}));
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_SubmitUnbounded_AcceptsTask_WhenFullAndFailingFast)
+{
+    Dispatcher dispatcher{4, QueueLimits{.capacity = 1, .overflow = OverflowPolicy::FailFast}};
+
+    dispatcher.Submit(TaskPriority::Interactive, [] {});
+    EXPECT_NO_THROW(dispatcher.SubmitUnbounded(TaskPriority::Interactive, [] {}));
+    EXPECT_EQ(2u, dispatcher.PendingCount());
+    EXPECT_THROW(dispatcher.Submit(TaskPriority::Interactive, [] {}), std::system_error) << "Unbounded tasks count towards the limit";
+
+    EXPECT_EQ(2u, RunAll(dispatcher));
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_Drain_DropsOldestBackgroundTasksFirst_WhenFullAndDroppingOldest)
+{
+    Dispatcher dispatcher{4, QueueLimits{.capacity = 3, .overflow = OverflowPolicy::DropOldest}};
+    std::string order;
+    std::string dropped;
+
+    for (const auto name : {'a', 'b', 'c'})
+        dispatcher.Submit(TaskPriority::Background, [&order, name] { order += name; });
+    dispatcher.Submit(TaskPriority::Interactive, [&order] { order += 'i'; });
+    dispatcher.Submit(TaskPriority::Interactive, [&order] { order += 'j'; });
+    EXPECT_EQ(5u, dispatcher.PendingCount()) << "Dropping happens on the consumer";
+
+    const auto ran = dispatcher.Drain([](Task& task) { task(); }, [&dropped, &order](Task& task) {
+        // Find out which task was dropped by running it into a separate string
+        const auto before = order;
+        task();
+        dropped += order.substr(before.size());
+        order = before;
+    });
+
+    EXPECT_EQ(3u, ran);
+    EXPECT_EQ("ab", dropped);
+    EXPECT_EQ("ijc", order);
+    EXPECT_EQ(0u, dispatcher.PendingCount());
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_Submit_Blocks_WhenFullAndBlocking)
+{
+    PriorityTaskDispatcher<Task, ConditionVariableWakeup> dispatcher{4, QueueLimits{.capacity = 1, .overflow = OverflowPolicy::Block}};
+    dispatcher.Submit(TaskPriority::Interactive, [] {});
+
+    std::atomic<bool> submitted = false;
+    std::thread producer([&] {
+        dispatcher.Submit(TaskPriority::Interactive, [] {});
+        submitted = true;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    EXPECT_FALSE(submitted);
+
+    // Running the first task frees the slot
+    dispatcher.Drain([](Task& task) { task(); });
+    producer.join();
+
+    EXPECT_TRUE(submitted);
+    EXPECT_EQ(1u, dispatcher.PendingCount());
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_Submit_DoesNotBlockConsumerThread_WhenFullAndBlocking)
+{
+    Dispatcher dispatcher{4, QueueLimits{.capacity = 1, .overflow = OverflowPolicy::Block}};
+    dispatcher.Submit(TaskPriority::Interactive, [&] {
+        dispatcher.Submit(TaskPriority::Interactive, [] {});
+        dispatcher.Submit(TaskPriority::Interactive, [] {});
+    });
+
+    EXPECT_EQ(1u, RunAll(dispatcher));
+    EXPECT_EQ(2u, dispatcher.PendingCount());
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_WatermarkCallbacks_AreCalledOnce_WhenQueueCrossesWatermarks)
+{
+    int high = 0;
+    int low = 0;
+    QueueLimits limits;
+    limits.highWatermark = 3;
+    limits.lowWatermark = 1;
+    limits.onHighWatermark = [&high] { ++high; };
+    limits.onLowWatermark = [&low] { ++low; };
+    Dispatcher dispatcher{4, limits};
+
+    for (int i = 0; i < 5; ++i)
+        dispatcher.Submit(TaskPriority::Background, [] {});
+    EXPECT_EQ(1, high);
+    EXPECT_EQ(0, low);
+
+    RunAll(dispatcher);
+    EXPECT_EQ(1, high);
+    EXPECT_EQ(1, low);
+
+    for (int i = 0; i < 3; ++i)
+        dispatcher.Submit(TaskPriority::Background, [] {});
+    EXPECT_EQ(2, high);
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_Shutdown_DropsPendingTasks_AndRejectsNewTasks)
+{
+    Dispatcher dispatcher{4, {}};
+    int executed = 0;
+    int dropped = 0;
+
+    dispatcher.Submit(TaskPriority::Interactive, [&] { ++executed; });
+    dispatcher.Submit(TaskPriority::Background, [&] { ++executed; });
+
+    EXPECT_EQ(2u, dispatcher.Shutdown([&dropped](Task&) { ++dropped; }));
+    EXPECT_EQ(0, executed);
+    EXPECT_EQ(2, dropped);
+    EXPECT_EQ(0u, dispatcher.PendingCount());
+
+    EXPECT_THROW(dispatcher.Submit(TaskPriority::Interactive, [] {}), std::system_error);
+    EXPECT_EQ(0u, dispatcher.PendingCount());
+}
+
+TEST(PriorityTaskDispatcherTests,
+    RequireThat_Shutdown_ReleasesBlockedProducers)
+{
+    PriorityTaskDispatcher<Task, ConditionVariableWakeup> dispatcher{4, QueueLimits{.capacity = 1, .overflow = OverflowPolicy::Block}};
+    dispatcher.Submit(TaskPriority::Interactive, [] {});
+
+    std::atomic<bool> rejected = false;
+    std::thread producer([&] {
+        try
+        {
+            dispatcher.Submit(TaskPriority::Interactive, [] {});
+        }
+        catch (const std::system_error& e)
+        {
+            rejected = e.code() == std::errc::operation_canceled;
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    EXPECT_EQ(1u, dispatcher.Shutdown([](Task&) {}));
+    producer.join();
+
+    EXPECT_TRUE(rejected);
+}
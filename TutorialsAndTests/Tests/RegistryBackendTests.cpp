@@ -0,0 +1,158 @@
+#include <ComUtility/RegistryBackend.h>
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+namespace
+{
+    const wchar_t* const ClassKey = L"Software\\Classes\\CLSID\\{d162d2f7-cdf4-44bc-8018-6058420bcfdc}";
+    const wchar_t* const ServerKey = L"Software\\Classes\\CLSID\\{d162d2f7-cdf4-44bc-8018-6058420bcfdc}\\InprocServer32";
+    const wchar_t* const InterfaceKey = L"Software\\Classes\\Interface\\{69fd604f-493c-4344-94b8-ea4179dd5113}";
+
+    /** A class and an interface registered the way AtlFreeServer does */
+    RegistryBatch CreateRegistration()
+    {
+        RegistryBatch batch;
+        batch.DeleteTree(ClassKey);
+        batch.SetValue(ClassKey, L"", L"GuardDog COM class");
+        batch.SetValue(ClassKey, L"AppID", L"{2b083fea-3681-4c9b-9ed1-3e866124a58d}");
+        batch.SetValue(ServerKey, L"", L"C:\\AtlFreeServer.dll");
+        batch.SetValue(ServerKey, L"ThreadingModel", L"Free");
+        batch.DeleteTree(InterfaceKey);
+        batch.SetValue(InterfaceKey, L"", L"IDog interface");
+        return batch;
+    }
+}
+
+TEST(RegistryBackendTests,
+    RequireThat_Write_OpensEachKeyOnce_WhenKeyHasManyValues)
+{
+    const auto batch = CreateRegistration();
+    MemoryRegistry registry;
+
+    EXPECT_FALSE(batch.Write(registry));
+
+    EXPECT_EQ(registry.WriteCount(), 3u);
+    EXPECT_EQ(registry.Value(ClassKey, L""), L"GuardDog COM class");
+    EXPECT_EQ(registry.Value(ClassKey, L"AppID"), L"{2b083fea-3681-4c9b-9ed1-3e866124a58d}");
+    EXPECT_EQ(registry.Value(ServerKey, L"ThreadingModel"), L"Free");
+    EXPECT_EQ(registry.Value(InterfaceKey, L""), L"IDog interface");
+}
+
+TEST(RegistryBackendTests,
+    RequireThat_Keys_AreGroupedCaseInsensitive_InOrderOfFirstUse)
+{
+    RegistryBatch batch;
+    batch.SetValue(L"Software\\A", L"First", L"1");
+    batch.SetValue(L"Software\\B", L"", L"2");
+    batch.SetValue(L"SOFTWARE\\a", L"first", L"3");
+
+    ASSERT_EQ(batch.Keys().size(), 2u);
+    EXPECT_EQ(batch.Keys()[0].path, L"Software\\A");
+    ASSERT_EQ(batch.Keys()[0].values.size(), 1u);
+    EXPECT_EQ(batch.Keys()[0].values[0].data, L"3");
+    EXPECT_EQ(batch.Keys()[1].path, L"Software\\B");
+}
+
+TEST(RegistryBackendTests,
+    RequireThat_WriteKey_CreatesParentKeys)
+{
+    MemoryRegistry registry;
+
+    EXPECT_FALSE(registry.WriteKey({ServerKey, {}}));
+
+    EXPECT_TRUE(registry.HasKey(L"Software"));
+    EXPECT_TRUE(registry.HasKey(L"Software\\Classes\\CLSID"));
+    EXPECT_TRUE(registry.HasKey(ClassKey));
+    EXPECT_TRUE(registry.HasKey(ServerKey));
+}
+
+TEST(RegistryBackendTests,
+    RequireThat_DeletedTrees_SkipsRepeatedTreesAndSubkeys)
+{
+    RegistryBatch batch;
+    batch.DeleteTree(ServerKey);
+    batch.DeleteTree(ClassKey);
+    batch.DeleteTree(ServerKey);
+    batch.DeleteTree(InterfaceKey);
+
+    ASSERT_EQ(batch.DeletedTrees().size(), 2u);
+    EXPECT_EQ(batch.DeletedTrees()[0], ClassKey);
+    EXPECT_EQ(batch.DeletedTrees()[1], InterfaceKey);
+}
+
+TEST(RegistryBackendTests,
+    RequireThat_Delete_RemovesAllRegisteredKeys_AndKeepsOtherKeys)
+{
+    const auto batch = CreateRegistration();
+    MemoryRegistry registry;
+    EXPECT_FALSE(registry.WriteKey({L"Software\\Classes\\CLSID\\{d162d2f7-cdf4-44bc-8018-6058420bcfdc} Other", {{L"", L"Keep"}}}));
+    EXPECT_FALSE(batch.Write(registry));
+
+    EXPECT_FALSE(batch.Delete(registry));
+
+    EXPECT_FALSE(registry.HasKey(ClassKey));
+    EXPECT_FALSE(registry.HasKey(ServerKey));
+    EXPECT_FALSE(registry.HasKey(InterfaceKey));
+    EXPECT_TRUE(registry.HasKey(L"Software\\Classes\\CLSID"));
+    EXPECT_EQ(registry.Value(L"Software\\Classes\\CLSID\\{d162d2f7-cdf4-44bc-8018-6058420bcfdc} Other", L""), L"Keep");
+}
+
+TEST(RegistryBackendTests,
+    RequireThat_Delete_Succeeds_WhenNothingIsRegistered)
+{
+    const auto batch = CreateRegistration();
+    MemoryRegistry registry;
+
+    EXPECT_FALSE(batch.Delete(registry));
+    EXPECT_EQ(registry.KeyCount(), 0u);
+}
+
+TEST(RegistryBackendTests,
+    RequireThat_Load_RestoresSavedRegistry_WhenValuesNeedEscaping)
+{
+    MemoryRegistry saved;
+    EXPECT_FALSE(saved.WriteKey({ServerKey, {{L"", L"C:\\Program Files\\\"Quoted\".dll"}, {L"ThreadingModel", L"Both"}}}));
+
+    std::wstringstream stream;
+    saved.Save(stream);
+    MemoryRegistry loaded;
+
+    EXPECT_FALSE(loaded.Load(stream));
+
+    EXPECT_EQ(loaded.KeyCount(), saved.KeyCount());
+    EXPECT_EQ(loaded.Value(ServerKey, L""), L"C:\\Program Files\\\"Quoted\".dll");
+    EXPECT_EQ(loaded.Value(ServerKey, L"ThreadingModel"), L"Both");
+}
+
+TEST(RegistryBackendTests,
+    RequireThat_Load_Fails_WhenValueIsOutsideOfKey)
+{
+    std::wstringstream stream{L"\"Name\"=\"Value\"\n"};
+    MemoryRegistry registry;
+
+    EXPECT_EQ(registry.Load(stream), std::errc::illegal_byte_sequence);
+}
+
+TEST(RegistryBackendTests,
+    RequireThat_FileRegistry_KeepsRegistration_BetweenInstances)
+{
+    const std::string path = "RegistryBackendTests.reg";
+    std::remove(path.c_str());
+
+    {
+        FileRegistry registry{path};
+        EXPECT_FALSE(CreateRegistration().Write(registry));
+        EXPECT_FALSE(registry.Flush());
+    }
+
+    FileRegistry registry{path};
+    EXPECT_EQ(registry.Value(ServerKey, L"ThreadingModel"), L"Free");
+
+    EXPECT_FALSE(CreateRegistration().Delete(registry));
+    EXPECT_FALSE(registry.Flush());
+    EXPECT_FALSE(FileRegistry{path}.HasKey(ClassKey));
+
+    std::remove(path.c_str());
+}
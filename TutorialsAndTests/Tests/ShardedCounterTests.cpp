@@ -0,0 +1,85 @@
+#include <ComUtility/ShardedCounter.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST(ShardedCounterTests,
+    RequireThat_Count_IsZero_WhenNothingIsCounted)
+{
+    const ShardedCounter counter;
+
+    EXPECT_EQ(counter.Count(), 0);
+}
+
+TEST(ShardedCounterTests,
+    RequireThat_Count_SumsIncrementsAndDecrements_OnAllThreads)
+{
+    ShardedCounter counter;
+
+    // More threads than shards, so that some threads share a shard
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 2 * ShardedCounter::ShardCount; ++i)
+    {
+        threads.emplace_back([&counter] {
+            for (int j = 0; j < 1000; ++j)
+                counter.Increment();
+            for (int j = 0; j < 999; ++j)
+                counter.Decrement();
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(counter.Count(), static_cast<int64_t>(2 * ShardedCounter::ShardCount));
+}
+
+TEST(ShardedCounterTests,
+    RequireThat_Count_IsZero_WhenDecrementedOnOtherThread)
+{
+    ShardedCounter counter;
+    counter.Increment();
+
+    std::thread{[&counter] { counter.Decrement(); }}.join();
+
+    EXPECT_EQ(counter.Count(), 0);
+}
+
+TEST(ShardedCounterTests,
+    RequireThat_Count_IsNeverZero_WhileObjectIsAlive)
+{
+    // One object is always alive. The threads take turns to create the next object, which
+    // is counted on their own shard, and then release the previous one, which was counted
+    // on the shard of the thread before.
+    constexpr int ThreadCount = 4;
+    ShardedCounter counter;
+    counter.Increment();
+
+    std::atomic<int> turn = 0;
+    std::atomic<bool> stop = false;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < ThreadCount; ++i)
+    {
+        threads.emplace_back([&counter, &turn, &stop, i] {
+            while (!stop)
+            {
+                if (turn != i)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                counter.Increment();
+                counter.Decrement();
+                turn = (i + 1) % ThreadCount;
+            }
+        });
+    }
+
+    for (int i = 0; i < 10000; ++i)
+        EXPECT_GT(counter.Count(), 0);
+
+    stop = true;
+    for (auto& thread : threads)
+        thread.join();
+}
@@ -0,0 +1,49 @@
+#include <ComUtility/SmallFunction.h>
+#include <gtest/gtest.h>
+#include <array>
+#include <memory>
+
+TEST(SmallFunctionTests,
+    RequireThat_Invoke_CallsStoredCallable)
+{
+    SmallFunction<int(int)> function = [](int value) { return value * 2; };
+
+    EXPECT_TRUE(function);
+    EXPECT_EQ(function(21), 42);
+}
+
+TEST(SmallFunctionTests,
+    RequireThat_SmallCallable_IsStoredInline_AndLargeCallableIsNot)
+{
+    auto small = [value = 1] { return value; };
+    auto large = [values = std::array<char, 128>{}] { return values[0]; };
+
+    EXPECT_TRUE(SmallFunction<int()>::StoresInline<decltype(small)>());
+    EXPECT_FALSE(SmallFunction<int()>::StoresInline<decltype(large)>());
+
+    SmallFunction<char()> function = large;
+    EXPECT_EQ(function(), 0);
+}
+
+TEST(SmallFunctionTests,
+    RequireThat_MoveOnlyCallable_CanBeStoredAndMoved)
+{
+    auto value = std::make_unique<int>(42);
+    SmallFunction<int()> function = [value = std::move(value)] { return *value; };
+
+    auto moved = std::move(function);
+
+    EXPECT_FALSE(function);
+    EXPECT_EQ(moved(), 42);
+}
+
+TEST(SmallFunctionTests,
+    RequireThat_Destructor_DestroysCallable)
+{
+    const auto value = std::make_shared<int>(42);
+    {
+        SmallFunction<void()> function = [value] {};
+        EXPECT_EQ(value.use_count(), 2);
+    }
+    EXPECT_EQ(value.use_count(), 1);
+}
@@ -0,0 +1,194 @@
+#include <ComUtility/ObjectPool.h>
+#include <ComUtility/TaskFuture.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST(TaskFutureTests,
+    RequireThat_Get_ReturnsValue_WhenSetFromOtherThread)
+{
+    TaskPromise<int> promise;
+    auto future = promise.get_future();
+
+    std::thread thread{[promise = std::move(promise)]() mutable {
+        promise.set_value(42);
+    }};
+
+    EXPECT_EQ(future.get(), 42);
+    EXPECT_FALSE(future.valid());
+    thread.join();
+}
+
+TEST(TaskFutureTests,
+    RequireThat_Get_ThrowsBrokenPromise_WhenPromiseIsDestroyedWithoutValue)
+{
+    TaskFuture<int> future;
+    {
+        TaskPromise<int> promise;
+        future = promise.get_future();
+    }
+
+    EXPECT_THROW(future.get(), std::future_error);
+}
+
+TEST(TaskFutureTests,
+    RequireThat_PackagedTask_StoresResultOfCallable)
+{
+    PackagedTask<int> task{[] { return 42; }};
+    auto future = task.get_future();
+
+    EXPECT_FALSE(future.is_ready());
+    task();
+
+    EXPECT_TRUE(future.is_ready());
+    EXPECT_EQ(future.get(), 42);
+}
+
+TEST(TaskFutureTests,
+    RequireThat_PackagedTask_StoresException_WhenCallableThrows)
+{
+    PackagedTask<int> task{[]() -> int { throw std::runtime_error("failure"); }};
+    auto future = task.get_future();
+
+    task();
+
+    EXPECT_THROW(future.get(), std::runtime_error);
+}
+
+TEST(TaskFutureTests,
+    RequireThat_PackagedTask_Skip_StoresValueWithoutRunningCallable)
+{
+    int calls = 0;
+    PackagedTask<int> task{[&] { return ++calls; }};
+    auto future = task.get_future();
+
+    task.skip(-1);
+
+    EXPECT_EQ(future.get(), -1);
+    EXPECT_EQ(calls, 0);
+}
+
+TEST(TaskFutureTests,
+    RequireThat_PackagedTaskOfVoid_SignalsCompletion)
+{
+    int calls = 0;
+    PackagedTask<void> task{[&] { ++calls; }};
+    auto future = task.get_future();
+
+    task();
+
+    EXPECT_TRUE(future.is_ready());
+    future.get();
+    EXPECT_EQ(calls, 1);
+}
+
+TEST(ObjectPoolTests,
+    RequireThat_New_ReusesMemory_WhenObjectIsDeleted)
+{
+    struct Object
+    {
+        int value;
+    };
+
+    const auto first = ObjectPool<Object>::New(Object{1});
+    ObjectPool<Object>::Delete(first);
+    const auto second = ObjectPool<Object>::New(Object{2});
+
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(second->value, 2);
+    ObjectPool<Object>::Delete(second);
+}
+
+TEST(ObjectPoolTests,
+    RequireThat_MemoryFreedOnOtherThread_IsReused)
+{
+    struct Object
+    {
+        int value;
+    };
+
+    // Free more than one batch on a worker thread, so that the blocks are handed over
+    std::vector<Object*> objects;
+    for (int i = 0; i < 1000; ++i)
+        objects.push_back(ObjectPool<Object>::New(Object{i}));
+
+    std::thread{[&] {
+        for (const auto object : objects)
+            ObjectPool<Object>::Delete(object);
+    }}.join();
+
+    const auto reused = ObjectPool<Object>::New(Object{0});
+    EXPECT_NE(std::find(objects.begin(), objects.end(), reused), objects.end());
+    ObjectPool<Object>::Delete(reused);
+}
+
+TEST(ObjectPoolTests,
+    RequireThat_Deallocate_HandsBlockOver_WhenThreadCacheIsDestroyed)
+{
+    struct Object
+    {
+        int value;
+    };
+
+    struct Holder
+    {
+        Object* object = nullptr;
+
+        ~Holder()
+        {
+            ObjectPool<Object>::Delete(object);
+        }
+    };
+
+    Object* deleted = nullptr;
+    std::thread{[&deleted] {
+        // Thread locals are destroyed in reverse order of construction, so the holder
+        // deletes its object after the cache, that is constructed by New, is gone
+        static thread_local Holder holder;
+        holder.object = ObjectPool<Object>::New(Object{1});
+        deleted = holder.object;
+    }}.join();
+
+    const auto reused = ObjectPool<Object>::New(Object{2});
+    EXPECT_EQ(deleted, reused);
+    EXPECT_EQ(1u, ObjectPool<Object>::BlockCount());
+    ObjectPool<Object>::Delete(reused);
+}
+
+TEST(ObjectPoolTests,
+    RequireThat_ReleaseMemory_FreesBlocksCachedByOtherThreads)
+{
+    struct Object
+    {
+        int value;
+    };
+
+    std::vector<Object*> objects;
+    for (int i = 0; i < 10; ++i)
+        objects.push_back(ObjectPool<Object>::New(Object{i}));
+    EXPECT_EQ(10u, ObjectPool<Object>::BlockCount());
+
+    // Fewer blocks than a batch, so they stay in the cache of the worker
+    std::promise<void> deleted;
+    std::promise<void> released;
+    std::thread worker{[&objects, &deleted, released = released.get_future()] {
+        for (const auto object : objects)
+            ObjectPool<Object>::Delete(object);
+        deleted.set_value();
+        released.wait();
+    }};
+    deleted.get_future().wait();
+
+    ObjectPool<Object>::ReleaseMemory();
+    EXPECT_EQ(0u, ObjectPool<Object>::BlockCount());
+
+    released.set_value();
+    worker.join();
+
+    const auto object = ObjectPool<Object>::New(Object{1});
+    EXPECT_EQ(1u, ObjectPool<Object>::BlockCount());
+    ObjectPool<Object>::Delete(object);
+}
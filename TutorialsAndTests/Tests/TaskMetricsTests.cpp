@@ -0,0 +1,112 @@
+#include <ComUtility/TaskMetrics.h>
+#include <gtest/gtest.h>
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+TEST(TaskMetricsTests,
+    RequireThat_Record_CountsDurationInPowerOfTwoBucket)
+{
+    LatencyHistogram histogram;
+    histogram.Record(0ns);
+    histogram.Record(1ns);
+    histogram.Record(1000ns);
+    histogram.Record(-5ns);
+
+    const auto snapshot = histogram.GetSnapshot();
+
+    EXPECT_EQ(snapshot.count, 4u);
+    EXPECT_EQ(snapshot.buckets[0], 2u) << "Zero and negative durations";
+    EXPECT_EQ(snapshot.buckets[1], 1u);
+    EXPECT_EQ(snapshot.buckets[10], 1u) << "512 <= 1000 < 1024";
+    EXPECT_EQ(snapshot.totalNanoseconds, 1001u);
+}
+
+TEST(TaskMetricsTests,
+    RequireThat_Record_PutsVeryLongDurationsInLastBucket)
+{
+    LatencyHistogram histogram;
+    histogram.Record(std::chrono::hours{24 * 365});
+
+    EXPECT_EQ(histogram.GetSnapshot().buckets[LatencyHistogram::BucketCount - 1], 1u);
+}
+
+TEST(TaskMetricsTests,
+    RequireThat_Percentile_ReturnsUpperBoundOfBucket)
+{
+    LatencyHistogram histogram;
+    for (int i = 0; i < 99; ++i)
+        histogram.Record(100ns);
+    histogram.Record(1ms);
+
+    const auto snapshot = histogram.GetSnapshot();
+
+    EXPECT_EQ(snapshot.Percentile(50), 128ns);
+    EXPECT_EQ(snapshot.Percentile(99), 1048576ns);
+    EXPECT_EQ(snapshot.Percentile(100), 1048576ns);
+    EXPECT_EQ(LatencyHistogram::Snapshot{}.Percentile(99), 0ns);
+}
+
+TEST(TaskMetricsTests,
+    RequireThat_Snapshot_CountsSubmittedAndCompletedTasks)
+{
+    TaskMetrics metrics;
+    const auto queued = TaskMetrics::Clock::now();
+
+    metrics.RecordSubmitted();
+    metrics.RecordSubmitted();
+    metrics.RecordCompleted(queued, queued + 2us, queued + 5us);
+
+    const auto snapshot = metrics.GetSnapshot(1);
+
+    EXPECT_EQ(snapshot.submitted, 2u);
+    EXPECT_EQ(snapshot.completed, 1u);
+    EXPECT_EQ(snapshot.queueDepth, 1u);
+    EXPECT_EQ(snapshot.queueWait.Mean(), 2us);
+    EXPECT_EQ(snapshot.runTime.Mean(), 3us);
+}
+
+TEST(TaskMetricsTests,
+    RequireThat_Snapshot_CountsDroppedTasks_WithoutLatency)
+{
+    TaskMetrics metrics;
+    metrics.RecordSubmitted();
+    metrics.RecordDropped();
+
+    const auto snapshot = metrics.GetSnapshot(0);
+
+    EXPECT_EQ(snapshot.dropped, 1u);
+    EXPECT_EQ(snapshot.completed, 0u);
+    EXPECT_EQ(snapshot.queueWait.count, 0u);
+}
+
+TEST(TaskMetricsTests,
+    RequireThat_RevertSubmitted_UndoesRecordSubmitted)
+{
+    TaskMetrics metrics;
+    metrics.RecordSubmitted();
+    metrics.RecordSubmitted();
+    metrics.RevertSubmitted();
+
+    EXPECT_EQ(metrics.GetSnapshot(0).submitted, 1u);
+}
+
+TEST(TaskMetricsTests,
+    RequireThat_Snapshots_CanBeSummed)
+{
+    TaskMetrics first;
+    TaskMetrics second;
+    first.RecordSubmitted();
+    second.RecordSubmitted();
+    second.RecordCompleted({}, {}, {});
+    second.RecordDropped();
+
+    auto sum = first.GetSnapshot(3);
+    sum += second.GetSnapshot(4);
+
+    EXPECT_EQ(sum.submitted, 2u);
+    EXPECT_EQ(sum.completed, 1u);
+    EXPECT_EQ(sum.dropped, 1u);
+    EXPECT_EQ(sum.queueDepth, 7u);
+    EXPECT_EQ(sum.runTime.count, 1u);
+}
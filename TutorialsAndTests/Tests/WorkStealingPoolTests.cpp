@@ -0,0 +1,145 @@
+#include <ComUtility/WorkStealingPool.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    /** Worker state that counts how many workers are initialized */
+    struct CountingState
+    {
+        explicit CountingState(std::atomic<int>* count) : m_count(count)
+        {
+            ++*m_count;
+        }
+
+        ~CountingState()
+        {
+            --*m_count;
+        }
+
+        std::atomic<int>* m_count;
+    };
+
+    struct FailingState
+    {
+        FailingState()
+        {
+            throw std::runtime_error("Failed to initialize worker");
+        }
+    };
+}
+
+TEST(WorkStealingPoolTests,
+    RequireThat_Submit_ReturnsResultOfCallable)
+{
+    WorkStealingPool<> pool{2};
+
+    auto future = pool.Submit([] { return 42; });
+
+    EXPECT_EQ(future.get(), 42);
+}
+
+TEST(WorkStealingPoolTests,
+    RequireThat_Submit_StoresException_WhenCallableThrows)
+{
+    WorkStealingPool<> pool{2};
+
+    auto future = pool.Submit([] { throw std::runtime_error("failure"); });
+
+    EXPECT_THROW(future.get(), std::runtime_error);
+}
+
+TEST(WorkStealingPoolTests,
+    RequireThat_Post_RunsCallable_WithoutFuture)
+{
+    std::atomic<int> calls = 0;
+    {
+        WorkStealingPool<> pool{2};
+        for (int i = 0; i < 10; ++i)
+            pool.Post([&calls] { ++calls; });
+    }
+
+    EXPECT_EQ(calls, 10) << "The pool runs queued tasks before it is destroyed";
+}
+
+TEST(WorkStealingPoolTests,
+    RequireThat_Submit_RunsTasksOnWorkerThreads)
+{
+    WorkStealingPool<> pool{4};
+
+    std::vector<TaskFuture<std::thread::id>> futures;
+    for (int i = 0; i < 100; ++i)
+        futures.push_back(pool.Submit([] { return std::this_thread::get_id(); }));
+
+    for (auto& future : futures)
+        EXPECT_NE(future.get(), std::this_thread::get_id());
+}
+
+TEST(WorkStealingPoolTests,
+    RequireThat_Constructor_InitializesWorkerStateOnce_PerWorker)
+{
+    std::atomic<int> count = 0;
+    {
+        WorkStealingPool<CountingState> pool{3, &count};
+        EXPECT_EQ(count, 3);
+
+        for (int i = 0; i < 100; ++i)
+            pool.Submit([] {});
+        EXPECT_EQ(count, 3);
+    }
+    EXPECT_EQ(count, 0);
+}
+
+TEST(WorkStealingPoolTests,
+    RequireThat_Constructor_Throws_WhenWorkerStateFails)
+{
+    EXPECT_THROW(WorkStealingPool<FailingState>{2}, std::runtime_error);
+}
+
+TEST(WorkStealingPoolTests,
+    RequireThat_IdleWorkers_StealTasksSubmittedByBusyWorker)
+{
+    WorkStealingPool<> pool{4};
+
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    std::atomic<int> remaining = 64;
+
+    // All children are queued on the worker that runs the parent
+    pool.Submit([&] {
+        for (int i = 0; i < 64; ++i)
+        {
+            pool.Submit([&] {
+                {
+                    std::lock_guard guard(mutex);
+                    threads.insert(std::this_thread::get_id());
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                --remaining;
+            });
+        }
+    }).get();
+
+    while (remaining != 0)
+        std::this_thread::yield();
+
+    EXPECT_GT(threads.size(), 1u);
+}
+
+TEST(WorkStealingPoolTests,
+    RequireThat_Destructor_RunsPendingTasks)
+{
+    std::atomic<int> executed = 0;
+    {
+        WorkStealingPool<> pool{2};
+        for (int i = 0; i < 1000; ++i)
+            pool.Submit([&] { ++executed; });
+    }
+    EXPECT_EQ(executed, 1000);
+}